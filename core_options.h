@@ -59,6 +59,8 @@ namespace DBP_Option
 		forcefps,
 		#ifndef DBP_STANDALONE
 		savestate,
+		savestate_compression,
+		rewind_budget,
 		#endif
 		strict_mode,
 		conf,
@@ -81,6 +83,9 @@ namespace DBP_Option
 		cycles_scale,
 		cycle_limit,
 		perfstats,
+		zip_cache,
+		dyncache,
+		idle_skip,
 		// Video
 		machine,
 		cga,
@@ -121,8 +126,13 @@ namespace DBP_Option
 		sblaster_type,
 		sblaster_adlib_mode,
 		sblaster_adlib_emu,
+		sblaster_adlib_thread,
 		gus,
 		tandysound,
+		resampler,
+		midi_thread,
+		midi_tsf_threads,
+		midi_polyphony,
 		swapstereo,
 		_OPTIONS_NULL_TERMINATOR, _OPTIONS_TOTAL,
 	};
@@ -262,15 +272,45 @@ static retro_core_option_v2_definition option_defs[DBP_Option::_OPTIONS_TOTAL] =
 		"Suporte para Salvar Estados", NULL,
 		"Certifique-se de testa-lo em cada jogo antes de usa-lo. Jogos complexos do DOS do final da era podem ter problemas." "\n"
 		"Lembre-se de que os estados salvos com configuracoes diferentes de video, CPU ou memoria nao podem ser carregados." "\n"
-		"O suporte ao rebobinamento tem um alto custo de desempenho e precisa de pelo menos 40 MB de buffer de rebobinamento.", NULL,
+		"O suporte ao rebobinamento tem um alto custo de desempenho e precisa de pelo menos 40 MB de buffer de rebobinamento." "\n"
+		"A captura rapida mantem uma copia da memoria emulada para pausar a emulacao apenas brevemente ao salvar." "\n"
+		"A rebobinagem no nucleo guarda apenas as diferencas entre os estados na memoria do nucleo. Ela e usada quando o frontend pede estados para rebobinar ou para executar a frente, os outros estados salvos continuam completos.", NULL,
 		DBP_OptionCat::General,
 		{
-			{ "on",       "Ativar estados de salvamento" },
-			{ "rewind",   "Ativar estados de salvamento com rebobinagem" },
-			{ "disabled", "Desativado" },
+			{ "on",         "Ativar estados de salvamento" },
+			{ "snapshot",   "Ativar estados de salvamento com captura rapida (usa mais memoria)" },
+			{ "rewind",     "Ativar estados de salvamento com rebobinagem" },
+			{ "corerewind", "Ativar estados de salvamento com rebobinagem no nucleo" },
+			{ "disabled",   "Desativado" },
 		},
 		"on"
 	},
+	{
+		"dosbox_pure_savestate_compression",
+		"Compressao de Estados Salvos", NULL,
+		"Comprime os estados salvos em blocos usando todos os nucleos do processador. Estados salvos ficam muito menores, mas salvar leva mais tempo." "\n"
+		"Estados comprimidos podem ser carregados independentemente desta opcao.", NULL,
+		DBP_OptionCat::General,
+		{
+			{ "false", "Desativado" },
+			{ "true", "Ativado" },
+		},
+		"false"
+	},
+	{
+		"dosbox_pure_rewind_budget",
+		"Memoria de Rebobinagem do Nucleo", NULL,
+		"Limite de memoria para as diferencas guardadas pela rebobinagem no nucleo. Uma copia completa da RAM e da memoria de video emuladas e mantida alem deste limite.", NULL,
+		DBP_OptionCat::General,
+		{
+			{ "64",   "64 MB" },
+			{ "128",  "128 MB" },
+			{ "256",  "256 MB (padrao)" },
+			{ "512",  "512 MB" },
+			{ "1024", "1 GB" },
+		},
+		"256"
+	},
 	#endif
 	{
 		"dosbox_pure_strict_mode",
@@ -571,7 +611,8 @@ static retro_core_option_v2_definition option_defs[DBP_Option::_OPTIONS_TOTAL] =
 	{
 		"dosbox_pure_perfstats",
 		"Avancado > Mostrar Estatisticas de Desempenho", NULL,
-		"Ative para mostrar estatisticas sobre desempenho e taxa de quadros e verificar se a emulacao e executada em velocidade maxima.", NULL,
+		"Ative para mostrar estatisticas sobre desempenho e taxa de quadros e verificar se a emulacao e executada em velocidade maxima." "\n"
+			"As informacoes detalhadas incluem o tempo gasto em eventos PIC, portas de E/S e callbacks, gravado em DOSBoxPureProfile.txt no diretorio de sistema ao desativar.", NULL,
 		DBP_OptionCat::Performance,
 		{
 			{ "none",     "Desativada" },
@@ -580,6 +621,49 @@ static retro_core_option_v2_definition option_defs[DBP_Option::_OPTIONS_TOTAL] =
 		},
 		"none"
 	},
+	{
+		"dosbox_pure_zip_cache",
+		"Avancado > Cache de Descompressao ZIP", NULL,
+		"Memoria usada por cada unidade ZIP montada para manter blocos ja descompactados de arquivos grandes." "\n"
+		"Evita descompactar os mesmos dados novamente quando o jogo reabre arquivos ou volta a ler partes anteriores.", NULL,
+		DBP_OptionCat::Performance,
+		{
+			{ "0",   "Desativado" },
+			{ "8",   "8 MB" },
+			{ "16",  "16 MB" },
+			{ "32",  "32 MB (padrao)" },
+			{ "64",  "64 MB" },
+			{ "128", "128 MB" },
+		},
+		"32"
+	},
+	{
+		"dosbox_pure_dyncache",
+		"Avancado > Cache do Nucleo Dinamico", NULL,
+		"Tamanho maximo da memoria para o codigo recompilado pelo nucleo dinamico da CPU. O cache comeca com 8 MB e, com um limite maior, dobra de tamanho apenas quando todo ele precisa ser recompilado em poucos segundos." "\n"
+		"Windows 9x e jogos grandes em modo protegido podem rodar mais rapido com um limite maior.", NULL,
+		DBP_OptionCat::Performance,
+		{
+			{ "8",   "8 MB (tamanho fixo, padrao)" },
+			{ "16",  "Ate 16 MB" },
+			{ "32",  "Ate 32 MB" },
+			{ "64",  "Ate 64 MB" },
+			{ "128", "Ate 128 MB" },
+		},
+		"8"
+	},
+	{
+		"dosbox_pure_idle_skip",
+		"Avancado > Pular Lacos de Espera", NULL,
+		"Detecta lacos curtos que apenas aguardam o retraco vertical, o teclado ou o relogio do BIOS e avanca o tempo emulado ate o proximo evento em vez de emula-los." "\n"
+		"Reduz o uso da CPU e da bateria sem alterar a velocidade do jogo, mas deixa o nucleo normal um pouco mais lento em outros codigos.", NULL,
+		DBP_OptionCat::Performance,
+		{
+			{ "false", "Desativado" },
+			{ "true", "Ativado" },
+		},
+		"false"
+	},
 
 	// Video
 	{
@@ -1073,6 +1157,15 @@ static retro_core_option_v2_definition option_defs[DBP_Option::_OPTIONS_TOTAL] =
 		},
 		"default"
 	},
+	{
+		"dosbox_pure_sblaster_adlib_thread",
+		"Avancado > Renderizar Adlib/FM em Thread Separada", NULL,
+		"Renderiza o chip OPL antecipadamente em uma thread propria, reduzindo o custo na thread de emulacao." "\n"
+		"Recomendado com o Nuked OPL3 em hardware mais fraco. A musica FM fica atrasada pela latencia escolhida.", NULL,
+		DBP_OptionCat::Audio,
+		{ { "0", "Desativado (padrao)" }, { "20", "Latencia de 20 ms" }, { "40", "Latencia de 40 ms" }, { "80", "Latencia de 80 ms" }, { "150", "Latencia de 150 ms" } },
+		"0"
+	},
 	{
 		"dosbox_pure_gus",
 		"Avancado > Habilitar Emulacao do Gravis Ultrasound (necessario reiniciar)", NULL,
@@ -1090,6 +1183,42 @@ static retro_core_option_v2_definition option_defs[DBP_Option::_OPTIONS_TOTAL] =
 		{ { "auto", "Desativado (padrao)" }, { "on", "Ativado" } },
 		"auto"
 	},
+	{
+		"dosbox_pure_resampler",
+		"Avancado > Qualidade da Reamostragem", NULL,
+		"Como o audio dos dispositivos (SoundBlaster, GUS, OPL, audio de CD) e convertido para a taxa de amostragem do mixer." "\n"
+		"O modo polifasico usa um filtro sinc com janela que reduz o aliasing com um custo um pouco maior de CPU.", NULL,
+		DBP_OptionCat::Audio,
+		{ { "linear", "Interpolacao linear (padrao)" }, { "polyphase", "Polifasico (alta qualidade)" } },
+		"linear"
+	},
+	{
+		"dosbox_pure_midi_thread",
+		"Avancado > Renderizar MIDI em Thread Separada", NULL,
+		"Renderiza o sintetizador MT-32 antecipadamente em uma thread propria, reduzindo o custo na thread de emulacao." "\n"
+		"A musica do MT-32 fica atrasada pela latencia escolhida.", NULL,
+		DBP_OptionCat::Audio,
+		{ { "0", "Desativado (padrao)" }, { "20", "Latencia de 20 ms" }, { "40", "Latencia de 40 ms" }, { "80", "Latencia de 80 ms" }, { "150", "Latencia de 150 ms" } },
+		"0"
+	},
+	{
+		"dosbox_pure_midi_tsf_threads",
+		"Avancado > Dividir Vozes do SoundFont entre Nucleos", NULL,
+		"Divide as vozes ativas do sintetizador SoundFont entre os nucleos disponiveis do processador." "\n"
+		"So e usado quando muitas vozes tocam ao mesmo tempo, nao adiciona latencia.", NULL,
+		DBP_OptionCat::Audio,
+		{ { "false", "Desativado (padrao)" }, { "true", "Ativado" } },
+		"false"
+	},
+	{
+		"dosbox_pure_midi_polyphony",
+		"Avancado > Polifonia Maxima de MIDI", NULL,
+		"Limita o numero de vozes simultaneas do sintetizador SoundFont. Ao atingir o limite, a voz mais antiga e substituida." "\n"
+		"Reduz o custo de processamento em musicas com muitas notas. Ao reduzir o limite durante a musica, as vozes mais antigas sao encerradas.", NULL,
+		DBP_OptionCat::Audio,
+		{ { "0", "Ilimitada (padrao)" }, { "32", "32 vozes" }, { "64", "64 vozes" }, { "128", "128 vozes" }, { "256", "256 vozes" } },
+		"0"
+	},
 	{
 		"dosbox_pure_swapstereo",
 		"Avancado > Trocar Canais Estereo", NULL,
@@ -34,6 +34,7 @@
 #include "include/dbp_serialize.h"
 #include "include/dbp_threads.h"
 #include "include/dbp_opengl.h"
+#include "include/dbp_profiler.h"
 #include "src/ints/int10.h"
 #include "src/dos/drives.h"
 #include "keyb2joypad.h"
@@ -58,9 +59,9 @@ static retro_system_av_info av_info;
 
 // DOSBOX STATE
 static enum DBP_State : Bit8u { DBPSTATE_BOOT, DBPSTATE_EXITED, DBPSTATE_SHUTDOWN, DBPSTATE_REBOOT, DBPSTATE_FIRST_FRAME, DBPSTATE_RUNNING } dbp_state;
-static enum DBP_SerializeMode : Bit8u { DBPSERIALIZE_STATES, DBPSERIALIZE_REWIND, DBPSERIALIZE_DISABLED } dbp_serializemode;
+static enum DBP_SerializeMode : Bit8u { DBPSERIALIZE_STATES, DBPSERIALIZE_STATES_SNAPSHOT, DBPSERIALIZE_REWIND, DBPSERIALIZE_REWIND_CORE, DBPSERIALIZE_DISABLED } dbp_serializemode;
 static bool dbp_game_running, dbp_pause_events, dbp_paused_midframe, dbp_frame_pending, dbp_biosreboot, dbp_system_cached, dbp_system_scannable, dbp_refresh_memmaps;
-static bool dbp_optionsupdatecallback, dbp_reboot_set64mem, dbp_use_network, dbp_had_game_running, dbp_strict_mode, dbp_legacy_save, dbp_wasloaded, dbp_skip_c_mount;
+static bool dbp_optionsupdatecallback, dbp_reboot_set64mem, dbp_use_network, dbp_had_game_running, dbp_strict_mode, dbp_legacy_save, dbp_wasloaded, dbp_skip_c_mount, dbp_serializecompress;
 static signed char dbp_menu_time, dbp_conf_loading, dbp_reboot_machine;
 static Bit8u dbp_alphablend_base;
 static float dbp_auto_target, dbp_last_fastforward;
@@ -72,12 +73,23 @@ static std::string dbp_content_path;
 static std::string dbp_content_name;
 static retro_time_t dbp_boot_time;
 static size_t dbp_serializesize;
+static Bit32u dbp_emu_serial, dbp_deflate_serial = (Bit32u)-1; // counts every time emulation continues, serial of the kept compressed state
 static Bit16s dbp_content_year, dbp_forcefps;
 
 // DOSBOX AUDIO/VIDEO
 static Bit8u buffer_active, dbp_overscan;
 static bool dbp_doublescan, dbp_padding;
-static struct DBP_Buffer { Bit32u *video, width, height, cap, pad_x, pad_y, border_color; float ratio; } dbp_buffers[3];
+static struct DBP_Buffer { Bit32u *video, width, height, cap, pad_x, pad_y, border_color; float ratio; Bit32u content_id, base_id, dirty_top, dirty_bottom; } dbp_buffers[3];
+static Bit32u dbp_content_id, dbp_submitted_id;
+
+// Gives a buffer that was drawn over after its comparison against the previous frame a new content id with every line changed
+static void DBP_MarkBufferChanged(DBP_Buffer& buf)
+{
+	buf.content_id = ++dbp_content_id;
+	buf.base_id = 0;
+	buf.dirty_top = 0;
+	buf.dirty_bottom = buf.height;
+}
 #ifndef DBP_STANDALONE
 static struct DBP_Audio { int16_t* audio; Bit32u length; } dbp_audio[2];
 static Bit8u dbp_audio_active;
@@ -239,7 +251,7 @@ static retro_input_state_t        input_state_cb;
 
 // PERF OVERLAY
 static enum DBP_Perf : Bit8u { DBP_PERF_NONE, DBP_PERF_SIMPLE, DBP_PERF_DETAILED } dbp_perf;
-static Bit32u dbp_perf_uniquedraw, dbp_perf_count, dbp_perf_totaltime;
+static Bit32u dbp_perf_uniquedraw, dbp_perf_count, dbp_perf_totaltime, dbp_perf_savestatetime;
 //#define DBP_ENABLE_WAITSTATS
 #ifdef DBP_ENABLE_WAITSTATS
 static Bit32u dbp_wait_pause, dbp_wait_finish, dbp_wait_paused, dbp_wait_continue;
@@ -520,7 +532,8 @@ static void DBP_ReportCoreMemoryMaps()
 	#endif
 
 	struct retro_memory_map mmaps = { mdescs, (unsigned)(!booted_os ? 3 : 2) };
-	environ_cb(RETRO_ENVIRONMENT_SET_MEMORY_MAPS, &mmaps);
+	extern bool dbp_memmaps_exposed;
+	if (environ_cb(RETRO_ENVIRONMENT_SET_MEMORY_MAPS, &mmaps)) dbp_memmaps_exposed = true;
 	dbp_refresh_memmaps = false;
 }
 
@@ -611,6 +624,7 @@ static void DBP_ThreadControl(DBP_ThreadCtlMode m)
 		case_TCM_EMULATION_CONTINUES:
 			if (pausedTimeStart) { dbp_paused_work += (Bit32u)(time_cb() - pausedTimeStart); pausedTimeStart = 0; }
 			if (dbp_serializesize && dbp_serializemode != DBPSERIALIZE_REWIND) dbp_serializesize = 0;
+			dbp_emu_serial++;
 			semDoContinue.Post();
 			return;
 	}
@@ -899,6 +913,24 @@ FILE* DBP_FileOpenContentOrSystem(const char* fname)
 	return fopen_wrap((tmp = DBP_GetSaveFile(SFT_SYSTEMDIR)).append(fname).c_str(), "rb");
 }
 
+FILE* DBP_FileOpenSystem(const char* fname, const char* mode)
+{
+	std::string tmp;
+	return fopen_wrap((tmp = DBP_GetSaveFile(SFT_SYSTEMDIR)).append(fname).c_str(), mode);
+}
+
+static void DBP_ProfilerStop()
+{
+	if (!DBP_Profiler::Active) return;
+	DBP_Profiler::SetActive(false);
+	if (FILE* f = DBP_FileOpenSystem("DOSBoxPureProfile.txt", "w"))
+	{
+		DBP_Profiler::Dump(f);
+		fclose(f);
+		log_cb(RETRO_LOG_INFO, "[DOSBOX] Perfil de emulacao de dispositivos gravado em %sDOSBoxPureProfile.txt\n", DBP_GetSaveFile(SFT_SYSTEMDIR).c_str());
+	}
+}
+
 static void DBP_SetDriveLabelFromContentPath(DOS_Drive* drive, const char *path, char letter = 'C', const char *path_file = NULL, const char *ext = NULL, bool forceAppendExtension = false)
 {
 	// Use content filename as drive label, cut off at file extension, the first occurrence of a ( or [ character or right white space.
@@ -1243,6 +1275,7 @@ static void DBP_Shutdown()
 	// to be called on the main thread
 	if (dbp_state == DBPSTATE_SHUTDOWN || dbp_state == DBPSTATE_BOOT) return;
 	DBP_ThreadControl(TCM_SHUTDOWN);
+	DBP_ProfilerStop();
 	if (!dbp_crash_message.empty())
 	{
 		retro_notify(0, RETRO_LOG_ERROR, "DOS crashed: %s", dbp_crash_message.c_str());
@@ -1561,12 +1594,25 @@ void GFX_EndUpdate(const Bit16u *changedLines)
 		buf.border_color = 0xDEADBEEF; // force redraw
 	}
 
+	// Find the range of lines that changed since the previous frame, frames without changes keep the content id of the previous frame
+	const DBP_Buffer& lbuf = dbp_buffers[buffer_active];
+	Bit32u dirty_top = 0, dirty_bottom = buf.height;
+	if (!voodoo_ogl_is_showing() && lbuf.video && lbuf.width == buf.width && lbuf.height == buf.height)
+	{
+		const Bit32u w = buf.width;
+		while (dirty_top != dirty_bottom && !memcmp(buf.video + dirty_top * w, lbuf.video + dirty_top * w, w * 4)) dirty_top++;
+		while (dirty_bottom != dirty_top && !memcmp(buf.video + (dirty_bottom - 1) * w, lbuf.video + (dirty_bottom - 1) * w, w * 4)) dirty_bottom--;
+	}
+	buf.dirty_top = dirty_top;
+	buf.dirty_bottom = dirty_bottom;
+	buf.base_id = lbuf.content_id;
+	buf.content_id = (dirty_top != dirty_bottom ? ++dbp_content_id : lbuf.content_id);
+
 	#ifndef DBP_ENABLE_FPS_COUNTERS
 	if (dbp_perf == DBP_PERF_DETAILED && !DBP_Run::autoinput.ptr)
 	#endif
 	{
-		const DBP_Buffer& lbuf = dbp_buffers[buffer_active];
-		bool diff = (!voodoo_ogl_is_showing() ? (!lbuf.video || lbuf.width != buf.width || lbuf.height != buf.height || memcmp(buf.video, lbuf.video, buf.width * buf.height * 4)) : voodoo_ogl_have_new_image());
+		bool diff = (!voodoo_ogl_is_showing() ? (dirty_top != dirty_bottom) : voodoo_ogl_have_new_image());
 		if (diff) { DBP_FPSCOUNT(dbp_fpscount_gfxend) dbp_perf_uniquedraw++; }
 	}
 	buffer_active = (buffer_active + 1) % 3;
@@ -1871,6 +1917,7 @@ void GFX_Events()
 			my *= dbp_mouse_speed;
 			Mouse_CursorMoved(mx, my, 0, 0, true);
 		}
+		zipDrive::PollIndexers();
 		#ifdef DBP_STANDALONE
 		if (dbps_emu_thread_func)
 		{
@@ -2318,6 +2365,16 @@ static bool check_variables()
 	DBP_Option::GetAndApply(sec_mixer, "swapstereo", DBP_Option::swapstereo);
 	extern bool dbp_swapstereo;
 	dbp_swapstereo = (bool)control->GetProp("mixer", "swapstereo")->GetValue(); // to also get dosbox.conf override
+	DBP_Option::GetAndApply(sec_mixer, "resampler", DBP_Option::resampler);
+	extern bool dbp_mixer_polyphase;
+	dbp_mixer_polyphase = !strcmp((const char*)control->GetProp("mixer", "resampler")->GetValue(), "polyphase");
+	extern Bit32u dbp_midi_thread_ms, dbp_midi_polyphony;
+	extern bool dbp_midi_tsf_threads;
+	dbp_midi_thread_ms = (Bit32u)atoi(DBP_Option::Get(DBP_Option::midi_thread));
+	dbp_midi_tsf_threads = (DBP_Option::Get(DBP_Option::midi_tsf_threads)[0] == 't');
+	dbp_midi_polyphony = (Bit32u)atoi(DBP_Option::Get(DBP_Option::midi_polyphony));
+	extern Bit32u dbp_opl_thread_ms;
+	dbp_opl_thread_ms = (Bit32u)atoi(DBP_Option::Get(DBP_Option::sblaster_adlib_thread));
 
 	if (dbp_state == DBPSTATE_BOOT)
 	{
@@ -2341,13 +2398,32 @@ static bool check_variables()
 		case 'd': dbp_perf = DBP_PERF_DETAILED; break;
 		default:  dbp_perf = DBP_PERF_NONE; break;
 	}
+	if (dbp_perf == DBP_PERF_DETAILED) DBP_Profiler::SetActive(true);
+	else DBP_ProfilerStop();
+	zipDrive::SetCacheBudget((Bit32u)atoi(DBP_Option::Get(DBP_Option::zip_cache)) * 1024 * 1024);
+	#if defined(C_DYNAMIC_X86) || defined(C_DYNREC)
+	extern void DBP_CPU_SetDynCacheLimit(Bit32u bytes);
+	extern void DBP_CPU_EnableDynCacheStats(bool enable);
+	DBP_CPU_SetDynCacheLimit((Bit32u)atoi(DBP_Option::Get(DBP_Option::dyncache)) * 1024 * 1024);
+	DBP_CPU_EnableDynCacheStats(dbp_perf != DBP_PERF_NONE);
+	#endif
+	CPU_IdleLoopDetect = (DBP_Option::Get(DBP_Option::idle_skip)[0] == 't');
 	#ifndef DBP_STANDALONE
 	switch (DBP_Option::Get(DBP_Option::savestate)[0])
 	{
 		case 'd': dbp_serializemode = DBPSERIALIZE_DISABLED; break;
 		case 'r': dbp_serializemode = DBPSERIALIZE_REWIND; break;
+		case 'c': dbp_serializemode = DBPSERIALIZE_REWIND_CORE; break;
+		case 's': dbp_serializemode = DBPSERIALIZE_STATES_SNAPSHOT; break;
 		default: dbp_serializemode = DBPSERIALIZE_STATES; break;
 	}
+	if (dbp_serializemode != DBPSERIALIZE_STATES_SNAPSHOT) DBPArchiveSnapshot::Free();
+	bool serializecompress = ((dbp_serializemode == DBPSERIALIZE_STATES || dbp_serializemode == DBPSERIALIZE_STATES_SNAPSHOT) && DBP_Option::Get(DBP_Option::savestate_compression)[0] == 't');
+	if (serializecompress != dbp_serializecompress) { dbp_serializecompress = serializecompress; dbp_serializesize = 0; dbp_deflate_serial = dbp_emu_serial - 1; }
+	if (!dbp_serializecompress) DBPArchiveDeflater::Free();
+	DBP_Option::SetDisplay(DBP_Option::savestate_compression, (dbp_serializemode == DBPSERIALIZE_STATES || dbp_serializemode == DBPSERIALIZE_STATES_SNAPSHOT));
+	DBP_Option::SetDisplay(DBP_Option::rewind_budget, (dbp_serializemode == DBPSERIALIZE_REWIND_CORE));
+	DBPArchiveRewind::SetBudget(dbp_serializemode == DBPSERIALIZE_REWIND_CORE ? (size_t)atoi(DBP_Option::Get(DBP_Option::rewind_budget)) * 1024 * 1024 : 0);
 	#endif
 	DBPArchive::accomodate_delta_encoding = (dbp_serializemode == DBPSERIALIZE_REWIND);
 	dbp_conf_loading = DBP_Option::Get(DBP_Option::conf)[0];
@@ -2632,6 +2708,10 @@ static void init_dosbox(bool forcemenu = false, bool reinit = false, const std::
 		dbp_game_running = dbp_had_game_running = false;
 		dbp_last_fastforward = false;
 		dbp_serializesize = 0;
+		dbp_deflate_serial = dbp_emu_serial - 1;
+		DBPArchiveRewind::Reset();
+		DBPArchiveSnapshot::Free();
+		DBPArchiveDeflater::Free();
 		dbp_audio_remain = 0;
 		DBP_SetIntercept(NULL);
 		for (size_t i = dbp_images.size(); i--;)
@@ -3022,7 +3102,7 @@ bool retro_load_game(const struct retro_game_info *info) //#4
 	if (voodoo_perf[0] == 'a' || voodoo_perf[0] == '4') // 3dfx wants to use OpenGL, request hardware render context
 	{
 		static struct sglproc { retro_proc_address_t* ptr; const char* name; bool required; } glprocs[] = { MYGL_FOR_EACH_PROC(MYGL_MAKEPROCARRENTRY) };
-		static unsigned prog_dosboxbuffer, vbo, vao, tex, fbo, lastw, lasth;
+		static unsigned prog_dosboxbuffer, vbo, vao, tex, fbo, lastw, lasth, lastid;
 
 		static const Bit8u testhwcontexts[] = { RETRO_HW_CONTEXT_OPENGL_CORE, RETRO_HW_CONTEXT_OPENGLES_VERSION, RETRO_HW_CONTEXT_OPENGLES3, RETRO_HW_CONTEXT_OPENGLES2, RETRO_HW_CONTEXT_OPENGL };
 		struct HWContext
@@ -3112,7 +3192,7 @@ bool retro_load_game(const struct retro_game_info *info) //#4
 				myglFramebufferTexture2D(MYGL_FRAMEBUFFER, MYGL_COLOR_ATTACHMENT0, MYGL_TEXTURE_2D, tex, 0);
 				if (myglGetError()) { DBP_ASSERT(0); goto gl_error; }
 
-				lastw = lasth = 0;
+				lastw = lasth = lastid = 0;
 				dbp_opengl_draw = Draw;
 				if (dbp_state == DBPSTATE_RUNNING || dbp_state == DBPSTATE_FIRST_FRAME) OnReset(voodoo_ogl_resetcontext, false);
 			}
@@ -3134,7 +3214,7 @@ bool retro_load_game(const struct retro_game_info *info) //#4
 				if (pauseThread) DBP_ThreadControl(TCM_PAUSE_FRAME);
 				func_voodoo_ogl();
 				if (pauseThread) DBP_ThreadControl(TCM_RESUME_FRAME);
-				if (context_destroyed) { prog_dosboxbuffer = vbo = vao = tex = fbo = lastw = lasth = 0; dbp_opengl_draw = NULL; }
+				if (context_destroyed) { prog_dosboxbuffer = vbo = vao = tex = fbo = lastw = lasth = lastid = 0; dbp_opengl_draw = NULL; }
 			}
 
 			static void Draw(const DBP_Buffer& buf)
@@ -3146,6 +3226,7 @@ bool retro_load_game(const struct retro_game_info *info) //#4
 				{
 					lastw = view_width;
 					lasth = view_height;
+					lastid = 0;
 					const float vertices[] = { // TODO: Flip view[1]/view[2] in voodoo_ogl_mainthread and use same vertices for both myglDrawArrays calls
 						-1.0f, -1.0f,   0.0f,1.0f, // bottom left
 						 1.0f, -1.0f,   1.0f,1.0f, // bottom right
@@ -3183,8 +3264,14 @@ bool retro_load_game(const struct retro_game_info *info) //#4
 				if (!is_voodoo_display)
 				#endif
 				{
+					// Only upload the lines that changed if the texture holds the frame the buffer was compared against
 					myglBindTexture(MYGL_TEXTURE_2D, tex);
-					myglTexSubImage2D(MYGL_TEXTURE_2D, 0, 0, 0, buf.width, buf.height, MYGL_RGBA, MYGL_UNSIGNED_BYTE, buf.video);
+					if (lastid && lastid == buf.content_id) {} // texture already holds this frame
+					else if (lastid && lastid == buf.base_id)
+						myglTexSubImage2D(MYGL_TEXTURE_2D, 0, 0, buf.dirty_top, buf.width, buf.dirty_bottom - buf.dirty_top, MYGL_RGBA, MYGL_UNSIGNED_BYTE, buf.video + buf.width * buf.dirty_top);
+					else
+						myglTexSubImage2D(MYGL_TEXTURE_2D, 0, 0, 0, buf.width, buf.height, MYGL_RGBA, MYGL_UNSIGNED_BYTE, buf.video);
+					lastid = buf.content_id;
 					if (is_voodoo_display)
 					{
 						myglEnable(MYGL_BLEND);
@@ -3490,6 +3577,7 @@ void retro_run(void)
 				#endif
 				{
 					for (Bit8u *p = (Bit8u*)buf.video, *pEnd = p + buf.width * buf.height * 4; p < pEnd; p += 56) p[2] = 255;
+					DBP_MarkBufferChanged(buf);
 					retro_sleep(10);
 				}
 			}
@@ -3506,6 +3594,7 @@ void retro_run(void)
 				{
 					#ifndef DBP_STANDALONE
 					dbp_intercept_next->gfx(buf);
+					DBP_MarkBufferChanged(buf);
 					#else
 					DBP_Buffer& osdbf = dbp_osdbuf[(buffer_active + 1) % 3];
 					if (!osdbf.video) osdbf.video = (Bit32u*)malloc(DBPS_OSD_WIDTH*DBPS_OSD_HEIGHT*4);
@@ -3547,7 +3636,8 @@ void retro_run(void)
 	bool skip_emulate = (fpsboost > 1 && (((fpsboost_count++)%fpsboost)!=0)) || DBP_NeedFrameSkip(false);
 	DBP_ThreadControl(skip_emulate ? TCM_PAUSE_FRAME : TCM_FINISH_FRAME);
 
-	Bit32u tpfActual = 0, tpfTarget = 0, tpfDraws = 0;
+	Bit32u tpfActual = 0, tpfTarget = 0, tpfDraws = 0, dynSize = 0, dynCompiles = 0, dynEvicts = 0, dynHits = 0, dynIndirectHits = 0, dynIndirectMisses = 0;
+	char profstats[256] = "";
 	#ifdef DBP_ENABLE_WAITSTATS
 	Bit32u waitPause = 0, waitFinish = 0, waitPaused = 0, waitContinue = 0;
 	#endif
@@ -3556,6 +3646,11 @@ void retro_run(void)
 		tpfActual = dbp_perf_totaltime / dbp_perf_count;
 		tpfTarget = (Bit32u)(1000000.f / render.src.fps);
 		tpfDraws = dbp_perf_uniquedraw;
+		DBP_Profiler::TakePeriodStats(profstats, sizeof(profstats), dbp_perf_totaltime);
+		#if defined(C_DYNAMIC_X86) || defined(C_DYNREC)
+		extern void DBP_CPU_TakeDynCacheStats(Bit32u& size, Bit32u& compiles, Bit32u& evicts, Bit32u& hits, Bit32u& indirect_hits, Bit32u& indirect_misses);
+		DBP_CPU_TakeDynCacheStats(dynSize, dynCompiles, dynEvicts, dynHits, dynIndirectHits, dynIndirectMisses);
+		#endif
 		#ifdef DBP_ENABLE_WAITSTATS
 		waitPause = dbp_wait_pause / dbp_perf_count, waitFinish = dbp_wait_finish / dbp_perf_count, waitPaused = dbp_wait_paused / dbp_perf_count, waitContinue = dbp_wait_continue / dbp_perf_count;
 		dbp_wait_pause = dbp_wait_finish = dbp_wait_paused = dbp_wait_continue = 0;
@@ -3601,6 +3696,20 @@ void retro_run(void)
 	if (tpfActual)
 	{
 		extern const char* DBP_CPU_GetDecoderName();
+		char statestats[320] = "";
+		size_t stateraw, statecomp, statelen = 0;
+		DBPArchiveDeflater::GetStats(stateraw, statecomp);
+		if (dbp_perf == DBP_PERF_DETAILED && statecomp)
+			statelen += snprintf(statestats, sizeof(statestats), "\nEstado Salvo: %u KB -> %u KB (%4.1f%%) em %u ms", (unsigned)(stateraw / 1024), (unsigned)(statecomp / 1024), (statecomp * 100.f / stateraw), (unsigned)(dbp_perf_savestatetime / 1000));
+		Bit32u zipused, ziphits, zipmisses;
+		zipDrive::GetCacheStats(zipused, ziphits, zipmisses);
+		if (dbp_perf == DBP_PERF_DETAILED && (ziphits || zipmisses))
+			statelen += snprintf(statestats + statelen, sizeof(statestats) - statelen, "\nCache ZIP: %u KB, Acertos: %u, Falhas: %u", (unsigned)(zipused / 1024), (unsigned)ziphits, (unsigned)zipmisses);
+		if (dbp_perf == DBP_PERF_DETAILED && dynSize && statelen < sizeof(statestats))
+			statelen += snprintf(statestats + statelen, sizeof(statestats) - statelen, "\nCache Dinamico: %u MB, Compilados: %u, Descartados: %u, Acertos: %4.1f%%", (unsigned)(dynSize / (1024 * 1024)),
+				(unsigned)dynCompiles, (unsigned)dynEvicts, (dynHits + dynCompiles ? dynHits * 100.f / (dynHits + dynCompiles) : 0.f));
+		if (dbp_perf == DBP_PERF_DETAILED && (dynIndirectHits || dynIndirectMisses) && statelen < sizeof(statestats))
+			snprintf(statestats + statelen, sizeof(statestats) - statelen, ", Saltos Indiretos: %4.1f%%", dynIndirectHits * 100.f / (dynIndirectHits + dynIndirectMisses));
 		if (dbp_perf == DBP_PERF_DETAILED)
 			retro_notify(-1500, RETRO_LOG_INFO, "Velocidade: %4.1f%%, DOS: %dx%d@%4.2fhz, Atual: %4.2ffps, Desenhado: %dfps, Ciclos: %u (%s)"
 				#ifdef DBP_ENABLE_WAITSTATS
@@ -3609,6 +3718,7 @@ void retro_run(void)
 				#ifdef DBP_ENABLE_FPS_COUNTERS
 				"\nRetro: %u, GfxStart: %u, GfxEnd: %u, Event: %u, SkipRun: %u, SkipRender: %u"
 				#endif
+				"%s%s"
 				, ((float)tpfTarget / (float)tpfActual * 100), (int)render.src.width, (int)render.src.height, render.src.fps, (1000000.f / tpfActual), tpfDraws, CPU_CycleMax, DBP_CPU_GetDecoderName()
 				#ifdef DBP_ENABLE_WAITSTATS
 				, waitPause, waitFinish, waitPaused, waitContinue
@@ -3616,7 +3726,7 @@ void retro_run(void)
 				#ifdef DBP_ENABLE_FPS_COUNTERS
 				, dbp_fpscount_retro, dbp_fpscount_gfxstart, dbp_fpscount_gfxend, dbp_fpscount_event, dbp_fpscount_skip_run, dbp_fpscount_skip_render
 				#endif
-				);
+				, statestats, profstats);
 		else
 			retro_notify(-1500, RETRO_LOG_INFO, "Velocidade da Emulacao: %4.1f%%",
 				((float)tpfTarget / (float)tpfActual * 100));
@@ -3629,6 +3739,7 @@ void retro_run(void)
 	double targetfps = DBP_GetFPS();
 	if (av_info.geometry.base_width != view_width || av_info.geometry.base_height != view_height || av_info.geometry.aspect_ratio != buf.ratio || av_info.timing.fps != targetfps || next_fpsboost != last_fpsboost)
 	{
+		dbp_submitted_id = 0; // always submit a full frame after a mode change
 		log_cb(RETRO_LOG_INFO, "[DOSBOX] Resolucao alterada %ux%u @ %.3fHz AR: %.5f => %ux%u @ %.3fHz AR: %.5f\n",
 			av_info.geometry.base_width, av_info.geometry.base_height, av_info.timing.fps, av_info.geometry.aspect_ratio,
 			view_width, view_height, av_info.timing.fps, buf.ratio);
@@ -3653,13 +3764,19 @@ void retro_run(void)
 		av_info.timing.fps = targetfps;
 	}
 
-	// submit video
-	if (skip_emulate)
+	// submit video, a frame identical to the one the frontend already has is submitted as a dupe
+	// frames the frontend throws away (like hidden run-ahead frames) don't count as submitted
+	int av_enable = 3;
+	environ_cb(RETRO_ENVIRONMENT_GET_AUDIO_VIDEO_ENABLE, &av_enable);
+	if (skip_emulate || (!dbp_opengl_draw && buf.content_id && buf.content_id == dbp_submitted_id))
 		video_cb(NULL, view_width, view_height, view_width * 4);
 	else if (dbp_opengl_draw)
 		dbp_opengl_draw(buf);
 	else
+	{
 		video_cb(buf.video, view_width, view_height, view_width * 4);
+		dbp_submitted_id = ((av_enable & 1) ? buf.content_id : 0);
+	}
 
 	#ifdef DBP_STANDALONE
 	if (dbp_intercept && dbp_osdbuf[&buf - dbp_buffers].video)
@@ -3701,7 +3818,7 @@ static bool retro_serialize_all(DBPArchive& ar, bool unlock_thread)
 			case DBPArchive::ERR_GAMENOTRUNNING:
 				if (ar.mode == DBPArchive::MODE_LOAD)
 					retro_notify(0, RETRO_LOG_WARN, "Nao e possivel carregar um estado de salvamento enquanto o jogo nao esta em execucao, inicie-o primeiro.");
-				else if (dbp_serializemode != DBPSERIALIZE_REWIND)
+				else if (dbp_serializemode != DBPSERIALIZE_REWIND && dbp_serializemode != DBPSERIALIZE_REWIND_CORE)
 					retro_notify(0, RETRO_LOG_ERROR, "%sNao e possivel %s enquanto o %s %s nao estiver em execucao."
 						#ifndef DBP_STANDALONE
 						"\nSe estiver usando o rebobinamento, certifique-se de modificar a opcao de nucleo relacionada."
@@ -3734,8 +3851,45 @@ static bool retro_serialize_all(DBPArchive& ar, bool unlock_thread)
 	return !ar.had_error;
 }
 
+static bool retro_serialize_deflate(bool unlock_thread)
+{
+	// The compressed state can be handed out again until emulation continues, which is usually when retro_serialize
+	// follows retro_serialize_size. If unlock_thread resumes emulation the serial changes and the state is used only once.
+	retro_time_t time_start = time_cb();
+	Bit32u serial = dbp_emu_serial;
+	DBPArchiveDeflater ar;
+	bool res;
+	if (dbp_serializemode == DBPSERIALIZE_STATES_SNAPSHOT) { DBPArchiveSnapshot snap; res = (retro_serialize_all(snap, unlock_thread) && snap.Write(ar)); }
+	else res = retro_serialize_all(ar, unlock_thread);
+	res = (res && ar.Finish() != 0);
+	dbp_deflate_serial = (res ? serial : serial - 1);
+	dbp_perf_savestatetime = (Bit32u)(time_cb() - time_start);
+	return res;
+}
+
+static bool retro_serialize_is_runahead()
+{
+	int ctx = RETRO_SAVESTATE_CONTEXT_NORMAL;
+	return (environ_cb(RETRO_ENVIRONMENT_GET_SAVESTATE_CONTEXT, &ctx) && ctx == RETRO_SAVESTATE_CONTEXT_RUNAHEAD_SAME_INSTANCE);
+}
+
+static bool retro_serialize_use_token()
+{
+	// Only states for rewind and run-ahead are guaranteed to be loaded by this same instance, save slots and netplay need full states
+	return (dbp_serializemode == DBPSERIALIZE_REWIND_CORE && retro_serialize_is_runahead());
+}
+
 size_t retro_serialize_size(void)
 {
+	if (retro_serialize_use_token()) return DBPArchiveRewind::TOKEN_SIZE;
+	// Run-ahead states are loaded again within a frame or two, compressing them every frame costs more than it saves
+	if (dbp_serializecompress && dbp_state != DBPSTATE_BOOT && !retro_serialize_is_runahead())
+	{
+		size_t raw_size, comp_size;
+		if (dbp_deflate_serial != dbp_emu_serial && !retro_serialize_deflate(false)) return 0;
+		DBPArchiveDeflater::GetStats(raw_size, comp_size);
+		return comp_size;
+	}
 	if (dbp_serializesize) return dbp_serializesize;
 	DBPArchiveCounter ar((dbp_state != DBPSTATE_RUNNING && dbp_state != DBPSTATE_FIRST_FRAME) || dbp_serializemode == DBPSERIALIZE_REWIND);
 	return dbp_serializesize = (retro_serialize_all(ar, false) ? ar.count : 0);
@@ -3743,6 +3897,41 @@ size_t retro_serialize_size(void)
 
 bool retro_serialize(void *data, size_t size)
 {
+	if (retro_serialize_use_token())
+	{
+		DBPArchiveRewind ar(DBPArchive::MODE_SAVE);
+		if (retro_serialize_all(ar, true)) return ar.Commit(data, size);
+		if ((ar.had_error != DBPArchive::ERR_DOSNOTRUNNING && ar.had_error != DBPArchive::ERR_GAMENOTRUNNING) || ar.GetOffset() > size) return false;
+		// Store just the header which marks the state as invalid like the frontend rewind mode does
+		memcpy(data, ar.GetData(), ar.GetOffset());
+		memset((Bit8u*)data + ar.GetOffset(), 0, size - ar.GetOffset());
+		return true;
+	}
+	if (dbp_serializecompress && !retro_serialize_is_runahead())
+	{
+		size_t raw_size, comp_size;
+		if (dbp_deflate_serial == dbp_emu_serial && dbp_state != DBPSTATE_BOOT && dbp_state != DBPSTATE_SHUTDOWN)
+		{
+			// Emulation stayed paused since retro_serialize_size compressed the state, resume it like retro_serialize_all would
+			DBP_ThreadControl(TCM_RESUME_FRAME);
+		}
+		else if (!retro_serialize_deflate(true)) return false;
+		DBPArchiveDeflater::GetStats(raw_size, comp_size);
+		if (comp_size > size) return false;
+		memcpy(data, DBPArchiveDeflater::GetData(), comp_size);
+		memset((Bit8u*)data + comp_size, 0, size - comp_size);
+		return true;
+	}
+	if (dbp_serializemode == DBPSERIALIZE_STATES_SNAPSHOT)
+	{
+		// Emulation is only paused while taking the snapshot, the state data gets written out while it continues running
+		DBPArchiveSnapshot snap;
+		if (!retro_serialize_all(snap, true)) return false;
+		DBPArchiveWriter ar(data, size);
+		if (!snap.Write(ar)) return false;
+		memset(ar.ptr, 0, ar.end - ar.ptr);
+		return true;
+	}
 	DBPArchiveWriter ar(data, size);
 	if (!retro_serialize_all(ar, true) && ((ar.had_error != DBPArchive::ERR_DOSNOTRUNNING && ar.had_error != DBPArchive::ERR_GAMENOTRUNNING) || dbp_serializemode != DBPSERIALIZE_REWIND)) return false;
 	memset(ar.ptr, 0, ar.end - ar.ptr);
@@ -3751,9 +3940,22 @@ bool retro_serialize(void *data, size_t size)
 
 bool retro_unserialize(const void *data, size_t size)
 {
+	dbp_submitted_id = 0; // the frontend might not be showing the last submitted frame anymore
+	if (DBPArchiveRewind::IsToken(data, size))
+	{
+		DBPArchiveRewind ar(DBPArchive::MODE_LOAD);
+		if (ar.Restore(data, size)) return retro_serialize_all(ar, true);
+		retro_notify(0, RETRO_LOG_ERROR, "%s%s", "Erro ao Carregar Estado: ", "O estado de rebobinagem nao esta mais disponivel na memoria");
+		return false;
+	}
+	if (DBPArchiveInflater::IsCompressed(data, size))
+	{
+		DBPArchiveInflater ar(data, size);
+		return retro_serialize_all(ar, true);
+	}
 	DBPArchiveReader ar(data, size);
 	bool res = retro_serialize_all(ar, true);
-	if ((ar.had_error != DBPArchive::ERR_DOSNOTRUNNING && ar.had_error != DBPArchive::ERR_GAMENOTRUNNING) || dbp_serializemode != DBPSERIALIZE_REWIND) return res;
+	if ((ar.had_error != DBPArchive::ERR_DOSNOTRUNNING && ar.had_error != DBPArchive::ERR_GAMENOTRUNNING) || (dbp_serializemode != DBPSERIALIZE_REWIND && dbp_serializemode != DBPSERIALIZE_REWIND_CORE)) return res;
 	if ((dbp_state != DBPSTATE_RUNNING && dbp_state != DBPSTATE_FIRST_FRAME) || dbp_game_running) retro_reset();
 	return true;
 }
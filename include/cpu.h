@@ -131,6 +131,12 @@ void CPU_RET(bool use32,Bitu bytes,Bitu oldeip);
 void CPU_IRET(bool use32,Bitu oldeip);
 void CPU_HLT(Bitu oldeip);
 
+/* Short loops that only poll an I/O port or memory fast-forward to the next event once they stop making progress */
+extern bool CPU_IdleLoopDetect;
+void CPU_IdleLoopJump(void);
+bool CPU_IdleLoopAt(PhysPt ip_point);
+Bits CPU_IdleLoopRun(void);
+
 bool CPU_POPF(Bitu use32);
 bool CPU_PUSHF(Bitu use32);
 bool CPU_CLI(void);
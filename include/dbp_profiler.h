@@ -0,0 +1,46 @@
+/*
+ *  Copyright (C) 2025 Bernhard Schelling
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef DOSBOX_DBP_PROFILER_H
+#define DOSBOX_DBP_PROFILER_H
+
+#include "config.h"
+#include <stdio.h>
+
+// Counts calls and host time spent in PIC event handlers, I/O port handlers and callbacks
+// Only active while detailed performance statistics are shown, otherwise each hook is a single branch
+struct DBP_Profiler
+{
+	enum Kind : Bit8u { KIND_PIC, KIND_IOREAD, KIND_IOWRITE, KIND_CALLBACK, _KIND_COUNT };
+
+	static bool Active;
+	static void SetActive(bool active);
+	static Bit64u Now(); // nanoseconds
+	static void Add(Kind kind, Bitu key, Bit64u start);
+
+	// Writes a short summary of the time spent since the last call relative to period_usec and starts a new period
+	static void TakePeriodStats(char* buf, size_t bufsize, Bit64u period_usec);
+
+	// Writes the totals collected since the profiler was activated
+	static void Dump(FILE* f);
+};
+
+#define DBP_PROFILE_BEGIN() Bit64u dbp_profile_start = (GCC_UNLIKELY(DBP_Profiler::Active) ? DBP_Profiler::Now() : 0)
+#define DBP_PROFILE_END(KIND, KEY) if (GCC_UNLIKELY(dbp_profile_start) && DBP_Profiler::Active) DBP_Profiler::Add(DBP_Profiler::KIND, (Bitu)(KEY), dbp_profile_start)
+
+#endif
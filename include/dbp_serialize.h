@@ -45,7 +45,7 @@ struct DBPArchive
 	template <typename T> DBPArchive& Serialize(T* v); // undefined, can't serialize pointer
 	template <typename T> INLINE DBPArchive& Serialize(T& v) { return SerializeBytes(&v, sizeof(v)); }
 	template <typename T, size_t N> INLINE DBPArchive& SerializeArray(T(& v)[N]) { return SerializeBytes(v, sizeof(v)); }
-	void SerializeSparse(void* p, size_t sz);
+	virtual void SerializeSparse(void* p, size_t sz);
 	void SerializePointers(void** ptrs, size_t num_ptrs, bool ignore_unknown, size_t num_luts, ...);
 	void DoExceptionList(void* p, size_t sz, size_t num_exceptions, ...);
 	template <typename T, typename X1> INLINE DBPArchive& SerializeExcept(T& v, X1& x1) { DoExceptionList(&v, sizeof(v), 1, &x1, sizeof(x1)); return *this; }
@@ -101,10 +101,12 @@ INLINE DBPArchive& operator<<(DBPArchive& ar, unsigned      long& i) { return ar
 INLINE DBPArchive& operator<<(DBPArchive& ar,   signed long long& i) { return ar.SerializeBytes(&i, sizeof(i)); }
 INLINE DBPArchive& operator<<(DBPArchive& ar, unsigned long long& i) { return ar.SerializeBytes(&i, sizeof(i)); }
 
-#define DBP_SERIALIZE_SET_POINTER_LIST(TYPE, MODULE, ...) TYPE DBPSerialize##TYPE##MODULE##Ptrs[] = { __VA_ARGS__, (TYPE)0 }
+#define DBP_SERIALIZE_SET_POINTER_LIST(TYPE, MODULE, ...) TYPE DBPSerialize##TYPE##MODULE##Ptrs[] = { __VA_ARGS__, (TYPE)0 }; extern const char DBPSerialize##TYPE##MODULE##Names[] = #__VA_ARGS__
 #define DBP_SERIALIZE_GET_POINTER_LIST(TYPE, MODULE) DBPSerialize##TYPE##MODULE##Ptrs
+#define DBP_SERIALIZE_GET_POINTER_NAMES(TYPE, MODULE) DBPSerialize##TYPE##MODULE##Names // comma separated source text of the list
 #define DBP_SERIALIZE_STATIC_POINTER_LIST(TYPE, MODULE, ...) static TYPE DBPSerialize##TYPE##MODULE##Ptrs[] = { __VA_ARGS__, (TYPE)0 }
 #define DBP_SERIALIZE_EXTERN_POINTER_LIST(TYPE, MODULE) extern TYPE DBPSerialize##TYPE##MODULE##Ptrs[]
+#define DBP_SERIALIZE_EXTERN_POINTER_NAMES(TYPE, MODULE) extern const char DBPSerialize##TYPE##MODULE##Names[]
 
 struct DBPArchiveOptional : public DBPArchive
 {
@@ -114,6 +116,7 @@ struct DBPArchiveOptional : public DBPArchive
 	virtual DBPArchive& SerializeByte(void* p);
 	virtual DBPArchive& SerializeBytes(void* p, size_t sz);
 	virtual size_t GetOffset();
+	virtual void SerializeSparse(void* p, size_t sz);
 	INLINE bool IsSkip() { return optionality == OPTIONAL_SKIP; }
 	INLINE bool IsReset() { return optionality == OPTIONAL_RESET; }
 	INLINE bool IsDiscard() { return optionality == OPTIONAL_DISCARD; }
@@ -156,6 +159,68 @@ struct DBPArchiveZeroer : DBPArchive
 	virtual size_t GetOffset() { return 0; }
 };
 
+// Core-side rewind buffer which keeps a ring of page-granular XOR/RLE deltas between successive states.
+// Instead of the full state, the frontend only gets a small token referring to an entry in this ring.
+// Sparse memory blocks are diffed page by page against a shadow copy so unchanged pages cost no memory.
+struct DBPArchiveRewind : DBPArchive
+{
+	enum { TOKEN_SIZE = 16 };
+	DBPArchiveRewind(EMode _mode);
+	virtual DBPArchive& SerializeByte(void* p) { return SerializeBytes(p, 1); }
+	virtual DBPArchive& SerializeBytes(void* p, size_t sz);
+	virtual DBPArchive& Discard(size_t sz);
+	virtual size_t GetOffset() { return offset; }
+	virtual void SerializeSparse(void* p, size_t sz);
+	const Bit8u* GetData();
+	bool Commit(void* token, size_t token_size); // call after serializing with MODE_SAVE to store the new state
+	bool Restore(const void* token, size_t token_size); // call before serializing with MODE_LOAD to rewind the ring
+	static bool IsToken(const void* data, size_t size);
+	static void SetBudget(size_t bytes); // setting 0 frees all memory
+	static void Reset();
+	private: size_t offset, block;
+};
+
+// Save archive that only takes a quick snapshot while the emulation thread is paused. Inline data gets buffered and
+// sparse blocks are copied into persistent double buffers (guest RAM incrementally by using the dirty page bitmap).
+// Write then outputs the same data DBPArchiveWriter would have produced and can be called after emulation resumed.
+struct DBPArchiveSnapshot : DBPArchive
+{
+	DBPArchiveSnapshot();
+	virtual DBPArchive& SerializeByte(void* p) { return SerializeBytes(p, 1); }
+	virtual DBPArchive& SerializeBytes(void* p, size_t sz);
+	virtual size_t GetOffset();
+	virtual void SerializeSparse(void* p, size_t sz);
+	bool Write(DBPArchive& ar);
+	static void Free();
+	private: size_t block;
+};
+
+// Save state container which deflates the serialized data in independent blocks that get compressed in parallel
+// and a reader which inflates block by block while loading. Both report offsets of the uncompressed data.
+struct DBPArchiveDeflater : DBPArchive
+{
+	DBPArchiveDeflater();
+	virtual DBPArchive& SerializeByte(void* p) { return SerializeBytes(p, 1); }
+	virtual DBPArchive& SerializeBytes(void* p, size_t sz);
+	virtual size_t GetOffset() { return offset; }
+	size_t Finish(); // compress and return the total size (0 on error)
+	static const Bit8u* GetData(); // result of the last Finish
+	static void GetStats(size_t& raw_size, size_t& comp_size);
+	static void Free();
+	private: size_t offset;
+};
+
+struct DBPArchiveInflater : DBPArchive
+{
+	DBPArchiveInflater(const void* ptr, size_t sz);
+	virtual DBPArchive& SerializeByte(void* p) { return SerializeBytes(p, 1); }
+	virtual DBPArchive& SerializeBytes(void* p, size_t sz);
+	virtual DBPArchive& Discard(size_t sz) { return SerializeBytes(NULL, sz); }
+	virtual size_t GetOffset() { return offset; }
+	static bool IsCompressed(const void* data, size_t size);
+	private: const Bit8u *ptr, *end, *table; size_t offset, raw_size, block_end; Bit32u block;
+};
+
 void DBPSerialize_All(DBPArchive& ar, bool dos_running = true, bool game_running = true);
 
 #endif
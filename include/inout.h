@@ -27,6 +27,10 @@
 #define IO_MD	0x4
 #define IO_MA	(IO_MB | IO_MW | IO_MD )
 
+/* CPU cycles per I/O access are CPU_CycleMax divided by these */
+#define IODELAY_READ_MICROSk (Bit32u)(1024/1.0)
+#define IODELAY_WRITE_MICROSk (Bit32u)(1024/0.75)
+
 typedef Bitu IO_ReadHandler(Bitu port,Bitu iolen);
 typedef void IO_WriteHandler(Bitu port,Bitu val,Bitu iolen);
 
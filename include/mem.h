@@ -149,13 +149,33 @@ void mem_writeb(PhysPt pt,Bit8u val);
 void mem_writew(PhysPt pt,Bit16u val);
 void mem_writed(PhysPt pt,Bit32u val);
 
+/* Dirty page tracking for incremental save states
+	A page gets marked when it is mapped writable into the TLB or written to by a handler or phys_write.
+	Clearing also unlinks the TLB entries of dirty pages so they get marked again when written to afterwards.
+*/
+extern Bit32u MemDirtyPages[(1024*1024)/32];
+void MEM_ClearDirtyPages(void);
+void MEM_SetDirtyPages(void);
+
+static INLINE void MEM_SetPageDirty(Bitu phys_page) {
+	MemDirtyPages[phys_page>>5]|=(1u<<(phys_page&31));
+}
+static INLINE bool MEM_IsPageDirty(Bitu phys_page) {
+	return (MemDirtyPages[phys_page>>5]&(1u<<(phys_page&31)))!=0;
+}
+
 static INLINE void phys_writeb(PhysPt addr,Bit8u val) {
+	MEM_SetPageDirty(addr>>12);
 	host_writeb(MemBase+addr,val);
 }
 static INLINE void phys_writew(PhysPt addr,Bit16u val){
+	MEM_SetPageDirty(addr>>12);
+	MEM_SetPageDirty((addr+1)>>12);
 	host_writew(MemBase+addr,val);
 }
 static INLINE void phys_writed(PhysPt addr,Bit32u val){
+	MEM_SetPageDirty(addr>>12);
+	MEM_SetPageDirty((addr+3)>>12);
 	host_writed(MemBase+addr,val);
 }
 
@@ -44,6 +44,9 @@ extern Bit8u MixTemp[MIXER_BUFSIZE];
 #define MAX_AUDIO ((1<<(16-1))-1)
 #define MIN_AUDIO -(1<<(16-1))
 
+//DBP: Taps per output sample of the polyphase resampler
+#define MIXER_POLY_TAPS 16
+
 class MixerChannel {
 public:
 	void SetVolume(float _left,float _right);
@@ -94,6 +97,10 @@ public:
 	//Simple way to lower the impact of DC offset. if MIXER_UPRAMP_STEPS is >0.
 	//Still work in progress and thus disabled for now.
 	Bits offset[2];
+	//DBP: Coefficient bank and input history (stored twice for contiguous reads) of the polyphase resampler
+	const Bit16s* poly_bank;
+	Bitu poly_add, poly_pos;
+	Bit16s poly_hist[2][MIXER_POLY_TAPS*2];
 	const char * name;
 	bool interpolate;
 	bool enabled;
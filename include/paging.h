@@ -94,6 +94,7 @@ void PAGING_ClearTLB(void);
 void PAGING_LinkPage(Bitu lin_page,Bitu phys_page);
 void PAGING_LinkPage_ReadOnly(Bitu lin_page,Bitu phys_page);
 void PAGING_UnlinkPages(Bitu lin_page,Bitu pages);
+void PAGING_UnlinkDirtyPages(void);
 /* This maps the page directly, only use when paging is disabled */
 void PAGING_MapPage(Bitu lin_page,Bitu phys_page);
 bool PAGING_MakePhysPage(Bitu & page);
@@ -144,7 +145,20 @@ union X86PageEntry {
 	X86_PageEntryBlock block;
 };
 
-#if !defined(USE_FULL_TLB)
+#if defined(USE_FULL_TLB)
+// The page handlers and physical pages are stored in tables covering 4 MB of linear address space each which only get
+// allocated when a page inside of them is linked, all other directory slots point to a shared table of init handlers
+#define TLB_REGION_SHIFT	10
+#define TLB_REGION_SIZE		(1<<TLB_REGION_SHIFT)
+#define TLB_REGION_MASK		(TLB_REGION_SIZE-1)
+#define TLB_REGIONS			(TLB_SIZE>>TLB_REGION_SHIFT)
+
+struct tlb_region {
+	PageHandler * readhandler[TLB_REGION_SIZE];
+	PageHandler * writehandler[TLB_REGION_SIZE];
+	Bit32u	phys_page[TLB_REGION_SIZE];
+};
+#else
 typedef struct {
 	HostPt read;
 	HostPt write;
@@ -165,9 +179,7 @@ struct PagingBlock {
 	struct {
 		HostPt read[TLB_SIZE];
 		HostPt write[TLB_SIZE];
-		PageHandler * readhandler[TLB_SIZE];
-		PageHandler * writehandler[TLB_SIZE];
-		Bit32u	phys_page[TLB_SIZE];
+		tlb_region * regions[TLB_REGIONS];
 	} tlb;
 #else
 	tlb_entry tlbh[TLB_SIZE];
@@ -219,20 +231,23 @@ static INLINE HostPt get_tlb_read(PhysPt address) {
 static INLINE HostPt get_tlb_write(PhysPt address) {
 	return paging.tlb.write[address>>12];
 }
+static INLINE tlb_region* get_tlb_region(PhysPt address) {
+	return paging.tlb.regions[address>>(12+TLB_REGION_SHIFT)];
+}
 static INLINE PageHandler* get_tlb_readhandler(PhysPt address) {
-	return paging.tlb.readhandler[address>>12];
+	return get_tlb_region(address)->readhandler[(address>>12)&TLB_REGION_MASK];
 }
 static INLINE PageHandler* get_tlb_writehandler(PhysPt address) {
-	return paging.tlb.writehandler[address>>12];
+	return get_tlb_region(address)->writehandler[(address>>12)&TLB_REGION_MASK];
 }
 
 /* Use these helper functions to access linear addresses in readX/writeX functions */
 static INLINE PhysPt PAGING_GetPhysicalPage(PhysPt linePage) {
-	return (paging.tlb.phys_page[linePage>>12]<<12);
+	return (get_tlb_region(linePage)->phys_page[(linePage>>12)&TLB_REGION_MASK]<<12);
 }
 
 static INLINE PhysPt PAGING_GetPhysicalAddress(PhysPt linAddr) {
-	return (paging.tlb.phys_page[linAddr>>12]<<12)|(linAddr&0xfff);
+	return (get_tlb_region(linAddr)->phys_page[(linAddr>>12)&TLB_REGION_MASK]<<12)|(linAddr&0xfff);
 }
 
 #else
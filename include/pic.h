@@ -31,6 +31,7 @@ typedef void (* PIC_EventHandler)(Bitu val);
 
 extern Bitu PIC_IRQCheck;
 extern Bitu PIC_Ticks;
+extern Bitu PIC_Slices; // counts calls of PIC_RunQueue, events and timer ticks only run in between
 
 static INLINE float PIC_TickIndex(void) {
 	return (CPU_CycleMax-CPU_CycleLeft-CPU_Cycles)/(float)CPU_CycleMax;
@@ -50,6 +50,7 @@
 #include "paging.h"
 #include "inout.h"
 #include "fpu.h"
+#include "pic.h"
 
 #define CACHE_MAXSIZE	(4096*3)
 #define CACHE_TOTAL		(1024*1024*8)
@@ -58,6 +59,7 @@
 #define CACHE_ALIGN		(16)
 #define DYN_HASH_SHIFT	(4)
 #define DYN_PAGE_HASH	(4096>>DYN_HASH_SHIFT)
+#define DYN_PAGE_ENTRIES	(256)
 #define DYN_LINKS		(16)
 
 //#define DYN_LOG 1 //Turn logging on
@@ -267,6 +269,11 @@ Bits CPU_Core_Dyn_X86_Run(void) {
 
 	/* Determine the linear address of CS:EIP */
 restart_core:
+	if (GCC_UNLIKELY(cache_resize_pending)) {
+		/* Replace the code cache while no block is running, gen_runcode is in the cache */
+		cache_resize();
+		gen_init();
+	}
 	PhysPt ip_point=SegPhys(cs)+reg_eip;
 #if C_DEBUG
 #if C_HEAVY_DEBUG
@@ -284,6 +291,14 @@ restart_core:
 	/* Find correct Dynamic Block to run */
 	CacheBlock * block=chandler->FindCacheBlock(ip_point&4095);
 	if (!block) {
+		if (GCC_UNLIKELY(CPU_IdleLoopDetect) && CPU_IdleLoopAt(ip_point)) {
+			/* Polling loops are left to the normal core which can skip them */
+			fpu_saver = auto_dh_fpu();
+			Bits nc_retcode=CPU_IdleLoopRun();
+			if (nc_retcode) return nc_retcode;
+			if (CPU_Cycles <= 0) return CBRET_NONE;
+			goto restart_core;
+		}
 		if (!chandler->invalidation_map || (chandler->invalidation_map[ip_point&4095]<4)) {
 			block=CreateCacheBlock(chandler,ip_point,32);
 		} else {
@@ -301,7 +316,7 @@ restart_core:
 			CPU_CycleLeft+=old_cycles;
 			return nc_retcode; 
 		}
-	}
+	} else cache_stats.hits++;
 run_block:
 	cache.block.running=0;
 	BlockReturn ret=gen_runcode(block->cache.start);
@@ -359,6 +374,7 @@ run_block:
 				block=temp_handler->FindCacheBlock(temp_ip & 4095);
 				if (!block) goto restart_core;
 				cache.block.running->LinkTo(ret==BR_Link2,block);
+				cache_stats.hits++;
 				goto run_block;
 			}
 		}
@@ -86,7 +86,7 @@ static bool MakeCodePage(Bitu lin_addr,CodePageHandler * &cph) {
 		cph=0;		return false;
 	}
 	/* Find a free CodePage */
-	if (!cache.free_pages) {
+	if (!cache.free_pages && !cache_addpage()) {
 		if (cache.used_pages!=decode.page.code) cache.used_pages->ClearRelease();
 		else {
 			if ((cache.used_pages->next) && (cache.used_pages->next!=decode.page.code))
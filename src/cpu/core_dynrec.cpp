@@ -59,6 +59,7 @@
 #define CACHE_ALIGN		(16)
 #define DYN_HASH_SHIFT	(4)
 #define DYN_PAGE_HASH	(4096>>DYN_HASH_SHIFT)
+#define DYN_PAGE_ENTRIES	(256)
 #define DYN_LINKS		(16)
 
 
@@ -107,7 +108,7 @@
 enum BlockReturn {
 	BR_Normal=0,
 	BR_Cycles,
-	BR_Link1,BR_Link2,
+	BR_Link1,BR_Link2,BR_LinkIndirect,
 	BR_Opcode,
 #if (C_DEBUG)
 	BR_OpcodeFull,
@@ -179,7 +180,13 @@ CacheBlockDynRec * LinkBlocks(BlockReturn ret) {
 		// see if the target is an already translated block
 		block=temp_handler->FindCacheBlock(temp_ip & 4095);
 		if (block) { // found it, link the current block to
-			cache.block.running->LinkTo(ret==BR_Link2,block);
+			if (ret==BR_LinkIndirect) {
+				// relink the indirect exit to the block it went to this time
+				cache.block.running->Unlink(2);
+				cache.block.running->indirect_ip=0-(Bit32u)temp_ip;
+			}
+			cache.block.running->LinkTo(ret-BR_Link1,block);
+			cache_stats.hits++;
 		}
 	}
 	return block;
@@ -199,6 +206,9 @@ CacheBlockDynRec * LinkBlocks(BlockReturn ret) {
 
 Bits CPU_Core_Dynrec_Run(void) {
 	for (;;) {
+		// the code cache was found too small, safe to replace it while no block is running
+		if (GCC_UNLIKELY(cache_resize_pending)) cache_resize();
+
 		// Determine the linear address of CS:EIP
 		PhysPt ip_point=SegPhys(cs)+reg_eip;
 		#if C_HEAVY_DEBUG
@@ -219,6 +229,13 @@ Bits CPU_Core_Dynrec_Run(void) {
 		// find correct Dynamic Block to run
 		CacheBlockDynRec * block=chandler->FindCacheBlock(ip_point&4095);
 		if (!block) {
+			// loops that only poll a port or memory are left to the normal core which can skip them
+			if (GCC_UNLIKELY(CPU_IdleLoopDetect) && CPU_IdleLoopAt(ip_point)) {
+				Bits nc_retcode=CPU_IdleLoopRun();
+				if (nc_retcode) return nc_retcode;
+				if (CPU_Cycles <= 0) return CBRET_NONE;
+				continue;
+			}
 			// no block found, thus translate the instruction stream
 			// unless the instruction is known to be modified
 			if (!chandler->invalidation_map || (chandler->invalidation_map[ip_point&4095]<4)) {
@@ -238,7 +255,7 @@ Bits CPU_Core_Dynrec_Run(void) {
 				CPU_CycleLeft+=old_cycles;
 				return nc_retcode;
 			}
-		}
+		} else cache_stats.hits++;
 
 run_block:
 		cache.block.running=0;
@@ -307,6 +324,9 @@ run_block:
 			return CPU_Core_Full_Run();
 #endif
 
+		case BR_LinkIndirect:
+			cache_stats.indirect_misses++;
+			// fallthrough
 		case BR_Link1:
 		case BR_Link2:
 			block=LinkBlocks(ret);
@@ -581,6 +581,8 @@ restart_prefix:
 				goto core_close_block;
 			case 2:
 				goto illegalopcode;
+			case 3:
+				goto core_close_indirect;
 			default:
 				break;
 			}
@@ -604,6 +606,11 @@ core_close_block:
 	dyn_return(BR_Normal);
 	dyn_closeblock();
 	goto finish_block;
+core_close_indirect:
+	dyn_reduce_cycles();
+	dyn_exit_indirect();
+	dyn_closeblock();
+	goto finish_block;
 illegalopcode:
 	// some unhandled opcode has been encountered
 	dyn_set_eip_last();
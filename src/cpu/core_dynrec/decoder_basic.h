@@ -171,7 +171,7 @@ static bool MakeCodePage(Bitu lin_addr,CodePageHandlerDynRec * &cph) {
 		return false;
 	}
 	// find a free CodePage
-	if (!cache.free_pages) {
+	if (!cache.free_pages && !cache_addpage()) {
 		if (cache.used_pages!=decode.page.code) cache.used_pages->ClearRelease();
 		else {
 			// try another page to avoid clearing our source-crosspage
@@ -643,6 +643,20 @@ static void dyn_return(BlockReturn retcode,bool ret_exception=false) {
 	gen_return_function();
 }
 
+// leave the block after an indirect jump or return, reg_eip has been set already
+// if CS:EIP is the address the indirect link was made for, continue with the linked
+// block directly, otherwise return to the core which looks up the target and relinks
+static void dyn_exit_indirect(void) {
+	gen_mov_word_to_reg(FC_OP1,&reg_eip,true);
+	gen_add(FC_OP1,DRCD_SEG_PHYS(cs));
+	gen_add(FC_OP1,&decode.block->indirect_ip);
+	const Bit8u* no_link=gen_create_branch_on_nonzero(FC_OP1,true);
+	if (cache_stats_enabled) gen_add_direct_word(&cache_stats.indirect_hits,1,true);
+	gen_jmp_ptr(&decode.block->link[2].to,offsetof(CacheBlockDynRec,cache.start));
+	gen_fill_branch(no_link);
+	dyn_return(BR_LinkIndirect);
+}
+
 static void dyn_run_code(void) {
 	gen_run_code();
 	gen_return_function();
@@ -857,10 +857,10 @@ static Bitu dyn_grp4_ev(void) {
 
 		gen_restore_addr_reg();
 		gen_mov_word_from_reg(FC_ADDR,decode.big_op?(void*)(&reg_eip):(void*)(&reg_ip),decode.big_op);
-		return 1;
+		return 3;
 	case 0x4:	// JMP Ev
 		gen_mov_word_from_reg(FC_OP1,decode.big_op?(void*)(&reg_eip):(void*)(&reg_ip),decode.big_op);
-		return 1;
+		return 3;
 	case 0x3:	// CALL Ep
 	case 0x5:	// JMP Ep
 		if (!decode.big_op) gen_extend_word(false,FC_OP1);
@@ -1192,7 +1192,7 @@ static void dyn_ret_near(Bitu bytes) {
 	gen_mov_word_from_reg(FC_RETOP,decode.big_op?(void*)(&reg_eip):(void*)(&reg_ip),true);
 
 	if (bytes) gen_add_direct_word(&reg_esp,bytes,true);
-	dyn_return(BR_Normal);
+	dyn_exit_indirect();
 	dyn_closeblock();
 }
 
@@ -61,7 +61,11 @@ static INLINE Bit32s Fetchds() {
 #define JumpCond16_b(COND) {						\
 	Bit8s adj=Fetchbs();							\
 	SAVEIP;											\
-	if (COND) reg_ip+=adj;							\
+	if (COND) {									\
+		reg_ip+=adj;								\
+		if (adj<0 && CPU_IdleLoopDetect)			\
+			CPU_IdleLoopJump();						\
+	}												\
 	continue;										\
 }
 
@@ -75,7 +79,11 @@ static INLINE Bit32s Fetchds() {
 #define JumpCond32_b(COND) {						\
 	Bit8s adj=Fetchbs();							\
 	SAVEIP;											\
-	if (COND) reg_eip+=adj;							\
+	if (COND) {									\
+		reg_eip+=adj;								\
+		if (adj<0 && CPU_IdleLoopDetect)			\
+			CPU_IdleLoopJump();						\
+	}												\
 	continue;										\
 }
 
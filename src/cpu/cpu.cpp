@@ -32,6 +32,8 @@
 #include "callback.h"
 #include "lazyflags.h"
 #include "support.h"
+#include "inout.h"
+#include "pic.h"
 
 Bitu DEBUG_EnableDebugger(void);
 extern void GFX_SetTitle(Bit32s cycles ,int frameskip,bool paused);
@@ -2071,6 +2073,180 @@ void CPU_HLT(Bitu oldeip) {
 	cpudecoder=&HLT_Decode;
 }
 
+bool CPU_IdleLoopDetect = false;
+
+enum { CPU_IDLELOOP_MAXLEN = 32, CPU_IDLELOOP_REJECTS = 64 };
+
+struct CPU_IdleLoop {
+	Bitu instructions;
+	Bitu port_count;
+	Bitu ports[2];
+	Bit8u masks[2]; // bits of a port value that can make the loop exit
+};
+
+static struct {
+	PhysPt loop;   // start of the loop last seen by CPU_IdleLoopJump and the state at its start
+	Bitu slice;
+	Bits left;
+	Bitu flags;
+	Bit32u regs[8];
+	Bits held;     // cycles of the current slice held back by CPU_IdleLoopRun
+	Bit64u rejects[CPU_IDLELOOP_REJECTS]; // loop starts known to do more than polling, tagged with PIC_Ticks/1024
+} cpu_idle;
+
+static bool CPU_IdleLoopModrm(PhysPt& ip, bool addr32) {
+	Bit8u modrm, sib;
+	if (mem_readb_checked(ip++, &modrm)) return false;
+	Bitu mod = modrm >> 6, rm = modrm & 7;
+	if (mod == 3) return true;
+	if (!addr32) {
+		ip += (mod == 0 ? (rm == 6 ? 2 : 0) : mod);
+		return true;
+	}
+	if (rm == 4) {
+		if (mem_readb_checked(ip++, &sib)) return false;
+		if (mod == 0 && (sib & 7) == 5) ip += 4;
+	}
+	ip += (mod == 0 ? (rm == 5 ? 4 : 0) : (mod == 1 ? 1 : 4));
+	return true;
+}
+
+/* Accepts the code at start if it is a short loop which jumps back to start and only reads from I/O ports
+   and memory, compares or masks what it read and leaves with forward jumps past its end. Every iteration
+   runs all of its instructions and it can only make progress if one of the values it reads changes. */
+static bool CPU_IdleLoopDecode(PhysPt start, CPU_IdleLoop& loop) {
+	extern Bitu vga_read_p3da(Bitu port,Bitu iolen);
+	loop.instructions = loop.port_count = 0;
+	PhysPt ip = start, exits = (PhysPt)-1;
+	Bits in_al = -1, test_al = -1; // port index of the value in AL right after IN and after TEST
+	while (ip - start < CPU_IDLELOOP_MAXLEN) {
+		bool op32 = cpu.code.big, addr32 = cpu.code.big;
+		Bit8u op, b;
+		Bitu port;
+		Bits read_al = in_al;
+		in_al = -1;
+		for (;;) {
+			if (mem_readb_checked(ip++, &op)) return false;
+			if (op == 0x26 || op == 0x2e || op == 0x36 || op == 0x3e || op == 0x64 || op == 0x65) continue;
+			if (op == 0x66) { op32 = !cpu.code.big; continue; }
+			if (op == 0x67) { addr32 = !cpu.code.big; continue; }
+			break;
+		}
+		loop.instructions++;
+		switch (op) {
+			case 0xe4: case 0xe5: // IN AL/eAX,Ib
+				if (mem_readb_checked(ip++, &b)) return false;
+				port = b;
+				goto in_port;
+			case 0xec: case 0xed: // IN AL/eAX,DX
+				port = reg_dx;
+			in_port:
+				// the VGA status changes at known times and the keyboard controller only in events
+				if (io_readhandlers[0][port] != vga_read_p3da && port != 0x60 && port != 0x64) return false;
+				if (loop.port_count == 2) return false;
+				loop.ports[loop.port_count] = port;
+				loop.masks[loop.port_count] = 0xff;
+				if (op == 0xe4 || op == 0xec) in_al = (Bits)loop.port_count;
+				loop.port_count++;
+				break;
+			case 0xa8: case 0x24: // TEST/AND AL,Ib
+				if (mem_readb_checked(ip++, &b)) return false;
+				if (read_al >= 0) loop.masks[read_al] = b;
+				if (read_al >= 0 && op == 0xa8) { test_al = read_al; continue; }
+				break;
+			case 0x3c: // CMP AL,Ib
+				ip += 1;
+				break;
+			case 0xa9: case 0x25: case 0x3d: // TEST/AND/CMP eAX,Iv
+				ip += (op32 ? 4 : 2);
+				break;
+			case 0xa0: case 0xa1: // MOV AL/eAX,Ov
+				ip += (addr32 ? 4 : 2);
+				break;
+			case 0x84: case 0x85: case 0x38: case 0x39: case 0x3a: case 0x3b: case 0x8a: case 0x8b: // TEST/CMP/MOV with register destination
+				if (!CPU_IdleLoopModrm(ip, addr32)) return false;
+				break;
+			case 0x80: case 0x81: case 0x83: case 0xf6: case 0xf7: // CMP/TEST Ev,Iv
+				if (mem_readb_checked(ip, &b)) return false;
+				if (((b >> 3) & 7) != (op >= 0xf6 ? 0 : 7)) return false;
+				if (!CPU_IdleLoopModrm(ip, addr32)) return false;
+				ip += ((op & 1) && op != 0x83 ? (op32 ? 4 : 2) : 1);
+				break;
+			case 0x70: case 0x71: case 0x72: case 0x73: case 0x74: case 0x75: case 0x76: case 0x77:
+			case 0x78: case 0x79: case 0x7a: case 0x7b: case 0x7c: case 0x7d: case 0x7e: case 0x7f: // Jcc Jb
+				if (mem_readb_checked(ip++, &b)) return false;
+				if (ip + (Bit8s)b == start) return (exits >= ip);
+				if ((Bit8s)b < 0) return false;
+				if (ip + (Bit8s)b < exits) exits = ip + (Bit8s)b;
+				break;
+			default:
+				return false;
+		}
+		// TEST only limits the bits that matter if nothing but conditional jumps follow it
+		if (test_al >= 0 && (op < 0x70 || op > 0x7f)) { loop.masks[test_al] = 0xff; test_al = -1; }
+	}
+	return false;
+}
+
+void CPU_IdleLoopJump(void) {
+	extern double VGA_StatusChangeDelay(Bit8u mask, double since);
+	extern Bitu vga_read_p3da(Bitu port,Bitu iolen);
+	PhysPt ip_point = SegPhys(cs) + reg_eip;
+	Bit64u reject = ((Bit64u)(PIC_Ticks >> 10) << 32) | ip_point;
+	Bit64u& slot = cpu_idle.rejects[ip_point & (CPU_IDLELOOP_REJECTS - 1)];
+	if (slot == reject) return;
+	CPU_IdleLoop loop;
+	if (!CPU_IdleLoopDecode(ip_point, loop)) { slot = reject; return; }
+
+	FillFlags();
+	Bit32u regs[8] = { reg_eax, reg_ecx, reg_edx, reg_ebx, reg_esp, reg_ebp, reg_esi, reg_edi };
+	Bits left = CPU_Cycles + cpu_idle.held, period = cpu_idle.left - left;
+	bool same = (cpu_idle.loop == ip_point && cpu_idle.slice == PIC_Slices && cpu_idle.flags == reg_flags && !memcmp(cpu_idle.regs, regs, sizeof(regs)));
+	cpu_idle.loop = ip_point;
+	cpu_idle.slice = PIC_Slices;
+	cpu_idle.left = left;
+	cpu_idle.flags = reg_flags;
+	memcpy(cpu_idle.regs, regs, sizeof(regs));
+
+	/* Skip if exactly one iteration ran since the last jump back without any event in between and ended in the state it started with,
+	   then nothing changes until a value it reads does. Memory and the keyboard controller only change in events. */
+	if (!same || period != (Bits)(loop.instructions + loop.port_count * (CPU_CycleMax / IODELAY_READ_MICROSk)) || GETFLAG(TF)) return;
+	Bits skip = left;
+	for (Bitu i = 0; i != loop.port_count; i++) {
+		if (io_readhandlers[0][loop.ports[i]] != vga_read_p3da) continue;
+		double until = VGA_StatusChangeDelay(loop.masks[i], PIC_FullIndex() - (double)period / CPU_CycleMax) * CPU_CycleMax - period;
+		if (until < (double)skip) skip = (until > 0 ? (Bits)until : 0);
+	}
+	skip -= skip % period; // end up at the same point of the loop as without skipping
+	if (skip <= 0) return;
+	CPU_IODelayRemoved += skip;
+	cpu_idle.left -= skip;
+	if (skip > CPU_Cycles) {
+		// the held back cycles sit in CPU_CycleLeft while CPU_IdleLoopRun runs
+		cpu_idle.held -= skip - CPU_Cycles;
+		CPU_CycleLeft -= skip - CPU_Cycles;
+		CPU_Cycles = 0;
+	} else CPU_Cycles -= skip;
+}
+
+bool CPU_IdleLoopAt(PhysPt ip_point) {
+	CPU_IdleLoop loop;
+	return CPU_IdleLoopDecode(ip_point, loop);
+}
+
+Bits CPU_IdleLoopRun(void) {
+	/* Let the normal core run a few iterations of the loop so CPU_IdleLoopJump can skip the rest of the slice.
+	   The held back cycles move to CPU_CycleLeft like PIC events do so PIC_TickIndex stays the same. They are
+	   left there afterwards, PIC_RunQueue then hands them out again and stops in time for events added meanwhile. */
+	Bits run = 3 * (CPU_IDLELOOP_MAXLEN + 2 * (CPU_CycleMax / IODELAY_READ_MICROSk));
+	cpu_idle.held = (CPU_Cycles > run ? CPU_Cycles - run : 0);
+	CPU_Cycles -= cpu_idle.held;
+	CPU_CycleLeft += cpu_idle.held;
+	Bits ret = CPU_Core_Normal_Run();
+	cpu_idle.held = 0;
+	return ret;
+}
+
 void CPU_ENTER(bool use32,Bitu bytes,Bitu level) {
 	level&=0x1f;
 	Bitu sp_index=reg_esp&cpu.stack.mask;
@@ -2694,6 +2870,13 @@ void DBPSerialize_CPU(DBPArchive& ar)
 		DBPSerialize_CPU_Core_Normal(ar);
 	}
 
+	// The loop last seen by CPU_IdleLoopJump decides if the next jump back skips, held is only set while CPU_IdleLoopRun runs
+	DBP_ASSERT(!cpu_idle.held);
+	if (ar.version >= 9)
+		ar.Serialize(cpu_idle.loop).Serialize(cpu_idle.slice).Serialize(cpu_idle.left).Serialize(cpu_idle.flags).SerializeArray(cpu_idle.regs).SerializeArray(cpu_idle.rejects);
+	else if (ar.mode == DBPArchive::MODE_LOAD)
+		memset(&cpu_idle, 0, sizeof(cpu_idle));
+
 	#if (C_DYNAMIC_X86)
 	void DBPSerialize_CPU_Core_Dyn_X86(DBPArchive& ar);
 	DBPSerialize_CPU_Core_Dyn_X86(ar);
@@ -71,8 +71,11 @@ class CodePageHandlerDynRec;	// forward
 class CacheBlockDynRec {
 public:
 	void Clear(void);
+	// let the code path point to the default linking code again
+	void Unlink(Bitu index);
 	// link this cache block to another block, index specifies the code
-	// path (always zero for unconditional links, 0/1 for conditional ones
+	// path (always zero for unconditional links, 0/1 for conditional ones,
+	// 2 for the target an indirect jump or return went to the last time)
 	void LinkTo(Bitu index,CacheBlockDynRec * toblock) {
 		assert(toblock);
 		link[index].to=toblock;
@@ -101,7 +104,8 @@ public:
 		CacheBlockDynRec * to;		// this block can transfer control to the to-block
 		CacheBlockDynRec * next;
 		CacheBlockDynRec * from;	// the from-block can transfer control to this block
-	} link[2];	// maximum two links (conditional jumps)
+	} link[3];	// maximum two links (conditional jumps) plus the indirect one
+	Bit32u indirect_ip;		// negated linear address link[2] was made for
 	CacheBlockDynRec * crossblock;
 };
 
@@ -125,7 +129,33 @@ static Bit8u * cache_code=NULL;
 static Bit8u * cache_code_link_blocks=NULL;
 
 static CacheBlockDynRec * cache_blocks=NULL;
-static CacheBlockDynRec link_blocks[2];		// default linking (specially marked)
+static CacheBlockDynRec link_blocks[3];		// default linking (specially marked)
+
+// additional cache blocks, allocated when the initial CACHE_BLOCKS run out
+#define CACHE_BLOCK_CHUNK	(CACHE_BLOCKS/8)
+struct CacheBlockChunk {
+	CacheBlockChunk * next;
+	CacheBlockDynRec blocks[CACHE_BLOCK_CHUNK];
+};
+static CacheBlockChunk * cache_block_chunks=NULL;
+
+// the code cache starts out with CACHE_TOTAL bytes and gets doubled up to cache_code_limit
+// whenever all of it has been recompiled within CACHE_GROW_TICKS, code pages are added in proportion
+#define CACHE_GROW_TICKS	(10000)
+static Bitu cache_code_size=CACHE_TOTAL;
+static Bitu cache_code_limit=CACHE_TOTAL;
+static Bitu cache_page_count;
+static Bitu cache_wrap_tick;
+static bool cache_resize_pending;
+
+static struct {
+	Bit32u compiles;	// translated blocks
+	Bit32u evicts;		// blocks overwritten to make room in the code cache
+	Bit32u hits;		// blocks found already translated
+	Bit32u indirect_hits;	// indirect jumps and returns that went straight to their linked block
+	Bit32u indirect_misses;	// indirect jumps and returns that had to be looked up
+} cache_stats;
+static bool cache_stats_enabled;	// counters in generated code are only emitted while stats are shown
 
 
 // the CodePageHandlerDynRec class provides access to the contained
@@ -157,6 +187,7 @@ public:
 
 		// initialize the maps with zero (no cache blocks as well as code present)
 		memset(&hash_map,0,sizeof(hash_map));
+		memset(&entry_map,0,sizeof(entry_map));
 		memset(&write_map,0,sizeof(write_map));
 		if (invalidation_map!=NULL) {
 			free(invalidation_map);
@@ -201,6 +232,7 @@ public:
 		addr&=4095;
 		if (host_readb(hostmem+addr)==(Bit8u)val) return;
 		host_writeb(hostmem+addr,val);
+		MEM_SetPageDirty(phys_page);
 		// see if there's code where we are writing to
 		if (!write_map[addr]) {
 			if (active_blocks) return;		// still some blocks in this page
@@ -222,6 +254,7 @@ public:
 		addr&=4095;
 		if (host_readw(hostmem+addr)==(Bit16u)val) return;
 		host_writew(hostmem+addr,val);
+		MEM_SetPageDirty(phys_page);
 		// see if there's code where we are writing to
 		if (!*(Bit16u*)&write_map[addr]) {
 			if (active_blocks) return;		// still some blocks in this page
@@ -248,6 +281,7 @@ public:
 		addr&=4095;
 		if (host_readd(hostmem+addr)==(Bit32u)val) return;
 		host_writed(hostmem+addr,val);
+		MEM_SetPageDirty(phys_page);
 		// see if there's code where we are writing to
 		if (!*(Bit32u*)&write_map[addr]) {
 			if (active_blocks) return;		// still some blocks in this page
@@ -292,6 +326,7 @@ public:
 			}
 		}
 		host_writeb(hostmem+addr,val);
+		MEM_SetPageDirty(phys_page);
 		return false;
 	}
 	bool writew_checked(PhysPt addr,Bitu val) {
@@ -325,6 +360,7 @@ public:
 			}
 		}
 		host_writew(hostmem+addr,val);
+		MEM_SetPageDirty(phys_page);
 		return false;
 	}
 	bool writed_checked(PhysPt addr,Bitu val) {
@@ -358,6 +394,7 @@ public:
 			}
 		}
 		host_writed(hostmem+addr,val);
+		MEM_SetPageDirty(phys_page);
 		return false;
 	}
 
@@ -367,6 +404,7 @@ public:
 		block->hash.next=hash_map[index];	// link to old block at index from the new block
 		block->hash.index=index;
 		hash_map[index]=block;				// put new block at hash position
+		entry_map[block->page.start&(DYN_PAGE_ENTRIES-1)]=block;	// likely the next one looked up
 		block->page.handler=this;
 		active_blocks++;
 	}
@@ -388,6 +426,8 @@ public:
 			//Will crash if a block isn't found, which should never happen.
 		}
 		*bwhere=block->hash.next;
+		if (entry_map[block->page.start&(DYN_PAGE_ENTRIES-1)]==block)
+			entry_map[block->page.start&(DYN_PAGE_ENTRIES-1)]=0;
 
 		// remove the cleared block from the write map
 		if (GCC_UNLIKELY(block->cache.wmapmask!=NULL)) {
@@ -441,10 +481,13 @@ public:
 	}
 
 	CacheBlockDynRec * FindCacheBlock(Bitu start) {
+		// the entry map remembers the last block found for the lower address bits
+		CacheBlockDynRec * * entry=&entry_map[start&(DYN_PAGE_ENTRIES-1)];
+		if (*entry && (*entry)->page.start==start) return *entry;
 		CacheBlockDynRec * block=hash_map[1+(start>>DYN_HASH_SHIFT)];
 		// see if there's a cache block present at the start address
 		while (block) {
-			if (block->page.start==start) return block;	// found
+			if (block->page.start==start) return *entry=block;	// found
 			block=block->hash.next;
 		}
 		return 0;	// none found
@@ -467,6 +510,8 @@ private:
 
 	// hash map to quickly find the cache blocks in this page
 	CacheBlockDynRec * hash_map[1+DYN_PAGE_HASH];
+	// direct mapped entry points, checked before walking the hash map
+	CacheBlockDynRec * entry_map[DYN_PAGE_ENTRIES];
 
 	Bitu active_blocks;		// the number of cache blocks in this page
 	Bitu active_count;		// delaying parameter to not immediately release a page
@@ -481,10 +526,37 @@ static INLINE void cache_addunusedblock(CacheBlockDynRec * block) {
 	cache.block.free=block;
 }
 
+static void cache_initblocks(CacheBlockDynRec * blocks,Bitu count) {
+	// chain the blocks up into the free list
+	cache.block.free=&blocks[0];
+	for (Bitu i=0;i<count-1;i++) {
+		blocks[i].link[0].to=(CacheBlockDynRec *)1;
+		blocks[i].link[1].to=(CacheBlockDynRec *)1;
+		blocks[i].cache.next=&blocks[i+1];
+	}
+}
+
+static void cache_freeblockchunks(void) {
+	while (cache_block_chunks) {
+		CacheBlockChunk * next=cache_block_chunks->next;
+		free(cache_block_chunks);
+		cache_block_chunks=next;
+	}
+}
+
 static CacheBlockDynRec * cache_getblock(void) {
 	// get a free cache block and advance the free pointer
 	CacheBlockDynRec * ret=cache.block.free;
-	if (!ret) E_Exit("Ran out of CacheBlocks" );
+	if (!ret) {
+		// allocate another chunk of cache blocks
+		CacheBlockChunk * chunk=(CacheBlockChunk*)malloc(sizeof(CacheBlockChunk));
+		if (!chunk) E_Exit("Ran out of CacheBlocks" );
+		memset(chunk,0,sizeof(CacheBlockChunk));
+		chunk->next=cache_block_chunks;
+		cache_block_chunks=chunk;
+		cache_initblocks(chunk->blocks,CACHE_BLOCK_CHUNK);
+		ret=cache.block.free;
+	}
 	cache.block.free=ret->cache.next;
 	ret->cache.next=0;
 	return ret;
@@ -493,7 +565,7 @@ static CacheBlockDynRec * cache_getblock(void) {
 void CacheBlockDynRec::Clear(void) {
 	Bitu ind;
 	// check if this is not a cross page block
-	if (hash.index) for (ind=0;ind<2;ind++) {
+	if (hash.index) for (ind=0;ind<3;ind++) {
 		CacheBlockDynRec * fromlink=link[ind].from;
 		link[ind].from=0;
 		while (fromlink) {
@@ -504,19 +576,7 @@ void CacheBlockDynRec::Clear(void) {
 
 			fromlink=nextlink;
 		}
-		if (link[ind].to!=&link_blocks[ind]) {
-			// not linked to the standard linkcode, find the block that links to this block
-			CacheBlockDynRec * * wherelink=&link[ind].to->link[ind].from;
-			while (*wherelink != this && *wherelink) {
-				wherelink = &(*wherelink)->link[ind].next;
-			}
-			// now remove the link
-			if(*wherelink) 
-				*wherelink = (*wherelink)->link[ind].next;
-			else {
-				LOG(LOG_CPU,LOG_ERROR)("Cache anomaly. please investigate");
-			}
-		}
+		Unlink(ind);
 	} else 
 		cache_addunusedblock(this);
 	if (crossblock) {
@@ -537,13 +597,33 @@ void CacheBlockDynRec::Clear(void) {
 }
 
 
+void CacheBlockDynRec::Unlink(Bitu index) {
+	if (link[index].to==&link_blocks[index]) return;
+	// not linked to the standard linkcode, find the block that links to this block
+	CacheBlockDynRec * * wherelink=&link[index].to->link[index].from;
+	while (*wherelink != this && *wherelink) {
+		wherelink = &(*wherelink)->link[index].next;
+	}
+	// now remove the link
+	if(*wherelink) 
+		*wherelink = (*wherelink)->link[index].next;
+	else {
+		LOG(LOG_CPU,LOG_ERROR)("Cache anomaly. please investigate");
+	}
+	link[index].to=&link_blocks[index];
+	link[index].next=0;
+}
+
+
 static CacheBlockDynRec * cache_openblock(void) {
 	CacheBlockDynRec * block=cache.block.active;
 	// check for enough space in this block
 	Bitu size=block->cache.size;
 	CacheBlockDynRec * nextblock=block->cache.next;
-	if (block->page.handler) 
+	if (block->page.handler) {
 		block->Clear();
+		cache_stats.evicts++;
+	}
 	// block size must be at least CACHE_MAXSIZE
 	while (size<CACHE_MAXSIZE) {
 		if (!nextblock)
@@ -551,8 +631,10 @@ static CacheBlockDynRec * cache_openblock(void) {
 		// merge blocks
 		size+=nextblock->cache.size;
 		CacheBlockDynRec * tempblock=nextblock->cache.next;
-		if (nextblock->page.handler) 
+		if (nextblock->page.handler) {
 			nextblock->Clear();
+			cache_stats.evicts++;
+		}
 		// block is free now
 		cache_addunusedblock(nextblock);
 		nextblock=tempblock;
@@ -562,6 +644,7 @@ skipresize:
 	block->cache.size=size;
 	block->cache.next=nextblock;
 	cache.pos=block->cache.start;
+	cache_stats.compiles++;
 	return block;
 }
 
@@ -570,10 +653,14 @@ static void cache_closeblock(void) {
 	// links point to the default linking code
 	block->link[0].to=&link_blocks[0];
 	block->link[1].to=&link_blocks[1];
+	block->link[2].to=&link_blocks[2];
 	block->link[0].from=0;
 	block->link[1].from=0;
+	block->link[2].from=0;
 	block->link[0].next=0;
 	block->link[1].next=0;
+	block->link[2].next=0;
+	block->indirect_ip=0;
 	// close the block with correct alignment
 	Bitu written=(Bitu)(cache.pos-block->cache.start);
 	if (written>block->cache.size) {
@@ -596,8 +683,11 @@ static void cache_closeblock(void) {
 		}
 	}
 	// advance the active block pointer
-	if (!block->cache.next || (block->cache.next->cache.start>(cache_code_start_ptr + CACHE_TOTAL - CACHE_MAXSIZE))) {
+	if (!block->cache.next || (block->cache.next->cache.start>(cache_code_start_ptr + cache_code_size - CACHE_MAXSIZE))) {
 //		LOG_MSG("Cache full restarting");
+		// grow the cache if the running code does not fit into it, happens at the next cache_resize
+		if (cache_code_size<cache_code_limit && PIC_Ticks-cache_wrap_tick<CACHE_GROW_TICKS) cache_resize_pending=true;
+		cache_wrap_tick=PIC_Ticks;
 		cache.block.active=cache.block.first;
 	} else {
 		cache.block.active=block->cache.next;
@@ -683,8 +773,51 @@ static void cache_block_closing(const Bit8u* block_start,Bitu block_size);
 
 static bool cache_initialized = false;
 
+// setup the default blocks for block linkage returns, they are placed around the run code
+static void cache_initlinkblocks(void) {
+#ifndef WORDS_BIGENDIAN
+	cache.pos=&cache_code_link_blocks[0];
+	link_blocks[0].cache.start=cache.pos;
+	// link code that returns with a special return code
+	dyn_return(BR_Link1,false);
+	cache.pos=&cache_code_link_blocks[32];
+	link_blocks[1].cache.start=cache.pos;
+	// link code that returns with a special return code
+	dyn_return(BR_Link2,false);
+#if (C_DYNREC)
+	cache.pos=&cache_code_link_blocks[64];
+	link_blocks[2].cache.start=cache.pos;
+	// link code for indirect jumps and returns
+	dyn_return(BR_LinkIndirect,false);
+#endif
+#else
+	cache.pos=&cache_code_link_blocks[PAGESIZE_TEMP-64];
+	link_blocks[0].cache.start=cache.pos;
+	// link code that returns with a special return code
+	// must be less than 32 bytes
+	dyn_return(BR_Link1,false);
+	cache_block_before_close();
+	cache_block_closing(link_blocks[0].cache.start, cache.pos-link_blocks[0].cache.start);
+
+	cache.pos=&cache_code_link_blocks[PAGESIZE_TEMP-32];
+	link_blocks[1].cache.start=cache.pos;
+	// link code that returns with a special return code
+	// must be less than 32 bytes
+	dyn_return(BR_Link2,false);
+	cache_block_before_close();
+	cache_block_closing(link_blocks[1].cache.start, cache.pos-link_blocks[1].cache.start);
+
+	cache.pos=&cache_code_link_blocks[PAGESIZE_TEMP-96];
+	link_blocks[2].cache.start=cache.pos;
+	// link code for indirect jumps and returns
+	// must be less than 32 bytes
+	dyn_return(BR_LinkIndirect,false);
+	cache_block_before_close();
+	cache_block_closing(link_blocks[2].cache.start, cache.pos-link_blocks[2].cache.start);
+#endif
+}
+
 static void cache_init(bool enable) {
-	Bits i;
 	if (enable) {
 		// see if cache is already initialized
 		if (cache_initialized) return;
@@ -694,23 +827,18 @@ static void cache_init(bool enable) {
 			cache_blocks=(CacheBlockDynRec*)malloc(CACHE_BLOCKS*sizeof(CacheBlockDynRec));
 			if(!cache_blocks) E_Exit("Allocating cache_blocks has failed");
 			memset(cache_blocks,0,sizeof(CacheBlockDynRec)*CACHE_BLOCKS);
-			cache.block.free=&cache_blocks[0];
 			// initialize the cache blocks
-			for (i=0;i<CACHE_BLOCKS-1;i++) {
-				cache_blocks[i].link[0].to=(CacheBlockDynRec *)1;
-				cache_blocks[i].link[1].to=(CacheBlockDynRec *)1;
-				cache_blocks[i].cache.next=&cache_blocks[i+1];
-			}
+			cache_initblocks(cache_blocks,CACHE_BLOCKS);
 		}
 		if (cache_code_start_ptr==NULL) {
 			// allocate the code cache memory
 #if defined (WIN32)
-			cache_code_start_ptr=(Bit8u*)VirtualAlloc(0,CACHE_TOTAL+CACHE_MAXSIZE+PAGESIZE_TEMP-1+PAGESIZE_TEMP,
+			cache_code_start_ptr=(Bit8u*)VirtualAlloc(0,cache_code_size+CACHE_MAXSIZE+PAGESIZE_TEMP-1+PAGESIZE_TEMP,
 				MEM_COMMIT,PAGE_EXECUTE_READWRITE);
 			if (!cache_code_start_ptr)
-				cache_code_start_ptr=(Bit8u*)malloc(CACHE_TOTAL+CACHE_MAXSIZE+PAGESIZE_TEMP-1+PAGESIZE_TEMP);
+				cache_code_start_ptr=(Bit8u*)malloc(cache_code_size+CACHE_MAXSIZE+PAGESIZE_TEMP-1+PAGESIZE_TEMP);
 #elif defined (HAVE_LIBNX)
-			cache_code_start_ptr=(Bit8u*)nxmmap(NULL, CACHE_TOTAL+CACHE_MAXSIZE+PAGESIZE_TEMP-1+PAGESIZE_TEMP);
+			cache_code_start_ptr=(Bit8u*)nxmmap(NULL, cache_code_size+CACHE_MAXSIZE+PAGESIZE_TEMP-1+PAGESIZE_TEMP);
 #elif defined (VITA)
 			sceBlock = getVMBlock();
 			if (sceBlock >= 0) {
@@ -723,7 +851,7 @@ static void cache_init(bool enable) {
 			cache_code_start_ptr=(Bit8u*)WUP_RWX_MEM_BASE;
 			//memset(cache_code_start_ptr, 0, (WUP_RWX_MEM_END - WUP_RWX_MEM_BASE));
 #else
-			cache_code_start_ptr=(Bit8u*)malloc(CACHE_TOTAL+CACHE_MAXSIZE+PAGESIZE_TEMP-1+PAGESIZE_TEMP);
+			cache_code_start_ptr=(Bit8u*)malloc(cache_code_size+CACHE_MAXSIZE+PAGESIZE_TEMP-1+PAGESIZE_TEMP);
 #endif
 			if(!cache_code_start_ptr) E_Exit("Allocating dynamic cache failed");
 
@@ -734,62 +862,40 @@ static void cache_init(bool enable) {
 			cache_code=cache_code+PAGESIZE_TEMP;
 
 #if (C_HAVE_MPROTECT)
-			if(mprotect(cache_code_link_blocks,CACHE_TOTAL+CACHE_MAXSIZE+PAGESIZE_TEMP,PROT_WRITE|PROT_READ|PROT_EXEC))
+			if(mprotect(cache_code_link_blocks,cache_code_size+CACHE_MAXSIZE+PAGESIZE_TEMP,PROT_WRITE|PROT_READ|PROT_EXEC))
 				LOG_MSG("Setting execute permission on the code cache has failed");
 #endif
 			CacheBlockDynRec * block=cache_getblock();
 			cache.block.first=block;
 			cache.block.active=block;
 			block->cache.start=&cache_code[0];
-			block->cache.size=CACHE_TOTAL;
+			block->cache.size=cache_code_size;
 			block->cache.next=0;						// last block in the list
+			cache_wrap_tick=PIC_Ticks;
 		}
-		// setup the default blocks for block linkage returns
-		cache.pos=&cache_code_link_blocks[0];
 #ifndef WORDS_BIGENDIAN
-		link_blocks[0].cache.start=cache.pos;
-		// link code that returns with a special return code
-		dyn_return(BR_Link1,false);
-		cache.pos=&cache_code_link_blocks[32];
-		link_blocks[1].cache.start=cache.pos;
-		// link code that returns with a special return code
-		dyn_return(BR_Link2,false);
-
+		cache_initlinkblocks();
 #if (C_DYNREC)
-		cache.pos=&cache_code_link_blocks[64];
+		cache.pos=&cache_code_link_blocks[96];
 		core_dynrec.runcode=(BlockReturn (*)(const Bit8u*))cache.pos;
-//		link_blocks[1].cache.start=cache.pos;
 		dyn_run_code();
 #endif
 #else
+		cache.pos=&cache_code_link_blocks[0];
 		core_dynrec.runcode=(BlockReturn (*)(const Bit8u*))cache.pos;
-		// can use op to PAGESIZE_TEMP-64 bytes
+		// can use up to PAGESIZE_TEMP-96 bytes, the link blocks are placed after it
 		dyn_run_code();
+		DBP_ASSERT(cache.pos<=&cache_code_link_blocks[PAGESIZE_TEMP-96]);
 		cache_block_before_close();
 		cache_block_closing(cache_code_link_blocks, cache.pos-cache_code_link_blocks);
-
-		cache.pos=&cache_code_link_blocks[PAGESIZE_TEMP-64];
-		link_blocks[0].cache.start=cache.pos;
-		// link code that returns with a special return code
-		// must be less than 32 bytes
-		dyn_return(BR_Link1,false);
-		cache_block_before_close();
-		cache_block_closing(link_blocks[0].cache.start, cache.pos-link_blocks[0].cache.start);
-
-		cache.pos=&cache_code_link_blocks[PAGESIZE_TEMP-32];
-		link_blocks[1].cache.start=cache.pos;
-		// link code that returns with a special return code
-		// must be less than 32 bytes
-		dyn_return(BR_Link2,false);
-		cache_block_before_close();
-		cache_block_closing(link_blocks[1].cache.start, cache.pos-link_blocks[1].cache.start);
+		cache_initlinkblocks();
 #endif
 
 		cache.free_pages=0;
 		cache.last_page=0;
 		cache.used_pages=0;
 		// setup the code pages
-		for (i=0;i<CACHE_PAGES;i++) {
+		for (cache_page_count=0;cache_page_count<CACHE_PAGES;cache_page_count++) {
 			CodePageHandlerDynRec * newpage=new CodePageHandlerDynRec();
 			newpage->next=cache.free_pages;
 			cache.free_pages=newpage;
@@ -797,6 +903,16 @@ static void cache_init(bool enable) {
 	}
 }
 
+static bool cache_addpage(void) {
+	// a grown code cache can hold the code of more pages before the oldest one gets released
+	if (cache_page_count>=CACHE_PAGES*(cache_code_size/CACHE_TOTAL)) return false;
+	CodePageHandlerDynRec * newpage=new CodePageHandlerDynRec();
+	newpage->next=cache.free_pages;
+	cache.free_pages=newpage;
+	cache_page_count++;
+	return true;
+}
+
 static void cache_close(void) {
 	//DBP: Memory cleanup
 	for (CodePageHandlerDynRec * cpage=cache.used_pages, * npage; cpage; cpage = npage) {
@@ -812,12 +928,13 @@ static void cache_close(void) {
 		free(cache_blocks);
 		cache_blocks = NULL;
 	}
+	cache_freeblockchunks();
 	if (cache_code_start_ptr != NULL) {
 #if defined (WIN32)
 		if (!VirtualFree(cache_code_start_ptr, 0, MEM_RELEASE))
 			free(cache_code_start_ptr);
 #elif defined (HAVE_LIBNX)
-		nxmunmap(cache_code_start_ptr, CACHE_TOTAL+CACHE_MAXSIZE+PAGESIZE_TEMP-1+PAGESIZE_TEMP);
+		nxmunmap(cache_code_start_ptr, cache_code_size+CACHE_MAXSIZE+PAGESIZE_TEMP-1+PAGESIZE_TEMP);
 #elif defined (VITA)
 		sceKernelFreeMemBlock(sceBlock);
 		sceBlock = 0;
@@ -840,28 +957,55 @@ static void DBPSerialize_cache_reset(void) {
 		}
 
 		DBP_ASSERT(cache_blocks);
+		cache_freeblockchunks();
 		memset(cache_blocks,0,sizeof(CacheBlockDynRec)*CACHE_BLOCKS);
-		cache.block.free=&cache_blocks[0];
-		for (Bits i=0;i<CACHE_BLOCKS-1;i++) {
-			cache_blocks[i].link[0].to=(CacheBlockDynRec *)1;
-			cache_blocks[i].link[1].to=(CacheBlockDynRec *)1;
-			cache_blocks[i].cache.next=&cache_blocks[i+1];
-		}
+		cache_initblocks(cache_blocks,CACHE_BLOCKS);
 
 		DBP_ASSERT(cache_code_start_ptr);
 		CacheBlockDynRec * block=cache_getblock();
 		cache.block.first=block;
 		cache.block.active=block;
 		block->cache.start=&cache_code[0];
-		block->cache.size=CACHE_TOTAL;
+		block->cache.size=cache_code_size;
 		block->cache.next=0;
+		cache_wrap_tick=PIC_Ticks;
 
 		/* Setup the default blocks for block linkage returns */
-		cache.pos=&cache_code_link_blocks[0];
-		link_blocks[0].cache.start=cache.pos;
-		dyn_return(BR_Link1,false);
-		cache.pos=&cache_code_link_blocks[32];
-		link_blocks[1].cache.start=cache.pos;
-		dyn_return(BR_Link2,false);
+		cache_initlinkblocks();
 	}
 }
+
+// called between blocks, replaces the code cache with one of the next size
+static void cache_resize(void) {
+	cache_resize_pending=false;
+	Bitu size=(cache_code_size*2<cache_code_limit ? cache_code_size*2 : cache_code_limit);
+	if (size==cache_code_size || !cache_initialized) return;
+	cache_close();
+	cache_code_size=size;
+	cache_init(true);
+}
+
+void DBP_CPU_SetDynCacheLimit(Bit32u bytes) {
+#if defined(VITA) || defined(WIIU) || defined(HAVE_LIBNX)
+	bytes=CACHE_TOTAL; // fixed size executable memory
+#endif
+	cache_code_limit=(bytes>CACHE_TOTAL ? bytes : CACHE_TOTAL);
+	if (cache_code_size<=cache_code_limit) return;
+	if (cache_initialized) cache_resize_pending=true;
+	else cache_code_size=cache_code_limit;
+}
+
+void DBP_CPU_EnableDynCacheStats(bool enable) {
+	// only affects blocks translated from now on
+	cache_stats_enabled=enable;
+}
+
+void DBP_CPU_TakeDynCacheStats(Bit32u& size, Bit32u& compiles, Bit32u& evicts, Bit32u& hits, Bit32u& indirect_hits, Bit32u& indirect_misses) {
+	size=(cache_initialized ? (Bit32u)cache_code_size : 0);
+	compiles=cache_stats.compiles;
+	evicts=cache_stats.evicts;
+	hits=cache_stats.hits;
+	indirect_hits=cache_stats.indirect_hits;
+	indirect_misses=cache_stats.indirect_misses;
+	memset(&cache_stats,0,sizeof(cache_stats));
+}
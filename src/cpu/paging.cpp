@@ -42,6 +42,11 @@
 
 #define CPU_HAS_WP_FLAG					(cpu.cr0&CR0_WRITEPROTECT)
 
+// Entries of the handler and physical page tables of a linear page, the region needs to be allocated before writing to them
+#define TLB_READHANDLER(page)			(paging.tlb.regions[(page)>>TLB_REGION_SHIFT]->readhandler[(page)&TLB_REGION_MASK])
+#define TLB_WRITEHANDLER(page)			(paging.tlb.regions[(page)>>TLB_REGION_SHIFT]->writehandler[(page)&TLB_REGION_MASK])
+#define TLB_PHYS_PAGE(page)				(paging.tlb.regions[(page)>>TLB_REGION_SHIFT]->phys_page[(page)&TLB_REGION_MASK])
+
 PagingBlock paging;
 
 //static Bit32u logcnt;
@@ -421,10 +426,10 @@ class PageFoilHandler : public PageHandler {
 private:
 	void work(PhysPt addr) {
 		Bitu lin_page = addr >> 12;
-		Bit32u phys_page = paging.tlb.phys_page[lin_page] & PHYSPAGE_ADDR;
+		Bit32u phys_page = TLB_PHYS_PAGE(lin_page) & PHYSPAGE_ADDR;
 
 		// set the page dirty in the tlb
-		paging.tlb.phys_page[lin_page] |= PHYSPAGE_DITRY;
+		TLB_PHYS_PAGE(lin_page) |= PHYSPAGE_DITRY;
 
 		// mark the page table entry dirty
 		X86PageEntry dir_entry, table_entry;
@@ -460,7 +465,7 @@ private:
 		if (handler->flags & PFLAG_WRITEABLE)
 			paging.tlb.write[lin_page] = handler->GetHostWritePt(phys_page) - (lin_page << 12);
 		else paging.tlb.write[lin_page]=0;
-		paging.tlb.writehandler[lin_page]=handler;
+		TLB_WRITEHANDLER(lin_page)=handler;
 	}
 
 	void read() {
@@ -513,7 +518,7 @@ class ExceptionPageHandler : public PageHandler {
 private:
 	PageHandler* getHandler(PhysPt addr) {
 		Bitu lin_page = addr >> 12;
-		Bit32u phys_page = paging.tlb.phys_page[lin_page] & PHYSPAGE_ADDR;
+		Bit32u phys_page = TLB_PHYS_PAGE(lin_page) & PHYSPAGE_ADDR;
 		PageHandler* handler = MEM_GetPageHandler(phys_page);
 		return handler;
 	}
@@ -526,7 +531,7 @@ private:
 		// the exception happens. Here we have gazillions of TLB entries so the
 		// exception occurs if we don't check for it.
 
-		Bitu old_attirbs = paging.tlb.phys_page[addr>>12] >> 30;
+		Bitu old_attirbs = TLB_PHYS_PAGE(addr>>12) >> 30;
 		X86PageEntry dir_entry, table_entry;
 		
 		dir_entry.load = phys_readd(GetPageDirectoryEntryAddr(addr));
@@ -561,7 +566,7 @@ private:
 
 	Bitu readb_through(PhysPt addr) {
 		Bitu lin_page = addr >> 12;
-		Bit32u phys_page = paging.tlb.phys_page[lin_page] & PHYSPAGE_ADDR;
+		Bit32u phys_page = TLB_PHYS_PAGE(lin_page) & PHYSPAGE_ADDR;
 		PageHandler* handler = MEM_GetPageHandler(phys_page);
 		if (handler->flags & PFLAG_READABLE) {
 			return host_readb(handler->GetHostReadPt(phys_page) + (addr&0xfff));
@@ -570,7 +575,7 @@ private:
 	}
 	Bitu readw_through(PhysPt addr) {
 		Bitu lin_page = addr >> 12;
-		Bit32u phys_page = paging.tlb.phys_page[lin_page] & PHYSPAGE_ADDR;
+		Bit32u phys_page = TLB_PHYS_PAGE(lin_page) & PHYSPAGE_ADDR;
 		PageHandler* handler = MEM_GetPageHandler(phys_page);
 		if (handler->flags & PFLAG_READABLE) {
 			return host_readw(handler->GetHostReadPt(phys_page) + (addr&0xfff));
@@ -579,7 +584,7 @@ private:
 	}
 	Bitu readd_through(PhysPt addr) {
 		Bitu lin_page = addr >> 12;
-		Bit32u phys_page = paging.tlb.phys_page[lin_page] & PHYSPAGE_ADDR;
+		Bit32u phys_page = TLB_PHYS_PAGE(lin_page) & PHYSPAGE_ADDR;
 		PageHandler* handler = MEM_GetPageHandler(phys_page);
 		if (handler->flags & PFLAG_READABLE) {
 			return host_readd(handler->GetHostReadPt(phys_page) + (addr&0xfff));
@@ -588,7 +593,7 @@ private:
 	}
 	void writeb_through(PhysPt addr, Bitu val) {
 		Bitu lin_page = addr >> 12;
-		Bit32u phys_page = paging.tlb.phys_page[lin_page] & PHYSPAGE_ADDR;
+		Bit32u phys_page = TLB_PHYS_PAGE(lin_page) & PHYSPAGE_ADDR;
 		PageHandler* handler = MEM_GetPageHandler(phys_page);
 		if (handler->flags & PFLAG_WRITEABLE) {
 			return host_writeb(handler->GetHostWritePt(phys_page) + (addr&0xfff), (Bit8u)val);
@@ -597,7 +602,7 @@ private:
 	}
 	void writew_through(PhysPt addr, Bitu val) {
 		Bitu lin_page = addr >> 12;
-		Bit32u phys_page = paging.tlb.phys_page[lin_page] & PHYSPAGE_ADDR;
+		Bit32u phys_page = TLB_PHYS_PAGE(lin_page) & PHYSPAGE_ADDR;
 		PageHandler* handler = MEM_GetPageHandler(phys_page);
 		if (handler->flags & PFLAG_WRITEABLE) {
 			return host_writew(handler->GetHostWritePt(phys_page) + (addr&0xfff), (Bit16u)val);
@@ -606,7 +611,7 @@ private:
 	}
 	void writed_through(PhysPt addr, Bitu val) {
 		Bitu lin_page = addr >> 12;
-		Bit32u phys_page = paging.tlb.phys_page[lin_page] & PHYSPAGE_ADDR;
+		Bit32u phys_page = TLB_PHYS_PAGE(lin_page) & PHYSPAGE_ADDR;
 		PageHandler* handler = MEM_GetPageHandler(phys_page);
 		if (handler->flags & PFLAG_WRITEABLE) {
 			return host_writed(handler->GetHostWritePt(phys_page) + (addr&0xfff), val);
@@ -1384,18 +1389,39 @@ bool PAGING_ForcePageInit(Bitu lin_addr) {
 }
 
 #if defined(USE_FULL_TLB)
-#include <stddef.h> //for offsetof
+// Shared by all 4 MB regions in which no page has been linked yet
+static tlb_region tlb_init_region;
+
+static INLINE void PAGING_AllocTLBRegion(Bitu lin_page) {
+	tlb_region*& region=paging.tlb.regions[lin_page>>TLB_REGION_SHIFT];
+	if (GCC_LIKELY(region!=&tlb_init_region)) return;
+	region=(tlb_region*)malloc(sizeof(tlb_region));
+	if (!region) E_Exit("Failed to allocate TLB region");
+	memcpy(region,&tlb_init_region,sizeof(tlb_region));
+}
+
+static INLINE void PAGING_ResetTLBEntry(Bitu lin_page) {
+	tlb_region* region=paging.tlb.regions[lin_page>>TLB_REGION_SHIFT];
+	// pages in a region that was never allocated were never linked so they don't need a reset
+	if (region==&tlb_init_region) return;
+	paging.tlb.read[lin_page]=0;
+	paging.tlb.write[lin_page]=0;
+	region->readhandler[lin_page&TLB_REGION_MASK]=init_page_handler;
+	region->writehandler[lin_page&TLB_REGION_MASK]=init_page_handler;
+}
 
 void PAGING_InitTLB(void) {
-	//DBP: Performance improvement
-	DBP_STATIC_ASSERT(offsetof(PagingBlock, tlb.write) == offsetof(PagingBlock, tlb.read) + sizeof(paging.tlb.read));
-	memset(paging.tlb.read, 0, sizeof(paging.tlb.read) + sizeof(paging.tlb.write));
-	for (Bitu i=0;i<TLB_SIZE;i++) paging.tlb.readhandler[i]=init_page_handler;
-	for (Bitu i=0;i<TLB_SIZE;i++) paging.tlb.writehandler[i]=init_page_handler;
-	paging.ur_links.used=0;
-	paging.krw_links.used=0;
-	paging.kr_links.used=0;
-	paging.links.used=0;
+	//DBP: Instead of filling the entire 1M entry tables (which commits all their memory) only the linked pages get reset
+	//     and the regions get released. This relies on read/write being 0 for every page not in the links list.
+	PAGING_ClearTLB();
+	for (Bitu i=0;i<TLB_REGIONS;i++) {
+		if (paging.tlb.regions[i] && paging.tlb.regions[i]!=&tlb_init_region) free(paging.tlb.regions[i]);
+		paging.tlb.regions[i]=&tlb_init_region;
+	}
+	for (Bitu i=0;i<TLB_REGION_SIZE;i++) {
+		tlb_init_region.readhandler[i]=init_page_handler;
+		tlb_init_region.writehandler[i]=init_page_handler;
+	}
 }
 
 void PAGING_ClearTLB(void) {
@@ -1406,8 +1432,8 @@ void PAGING_ClearTLB(void) {
 		Bitu page=*entries++;
 		paging.tlb.read[page]=0;
 		paging.tlb.write[page]=0;
-		paging.tlb.readhandler[page]=init_page_handler;
-		paging.tlb.writehandler[page]=init_page_handler;
+		TLB_READHANDLER(page)=init_page_handler;
+		TLB_WRITEHANDLER(page)=init_page_handler;
 	}
 	paging.ur_links.used=0;
 	paging.krw_links.used=0;
@@ -1417,22 +1443,31 @@ void PAGING_ClearTLB(void) {
 
 void PAGING_UnlinkPages(Bitu lin_page,Bitu pages) {
 	for (;pages>0;pages--) {
-		paging.tlb.read[lin_page]=0;
-		paging.tlb.write[lin_page]=0;
-		paging.tlb.readhandler[lin_page]=init_page_handler;
-		paging.tlb.writehandler[lin_page]=init_page_handler;
+		PAGING_ResetTLBEntry(lin_page);
 		lin_page++;
 	}
 }
 
+void PAGING_UnlinkDirtyPages(void) {
+	// unlink writable entries into dirty guest RAM pages so the next write marks them again, other links can stay
+	HostPt mem_base=GetMemBase(), mem_end=mem_base+MEM_TotalPages()*MEM_PAGE_SIZE;
+	for (Bitu i=0;i<paging.links.used;i++) {
+		Bitu page=paging.links.entries[i];
+		if (!paging.tlb.write[page]) continue;
+		HostPt host=paging.tlb.write[page]+(page<<12);
+		if (host<mem_base || host>=mem_end || !MEM_IsPageDirty((Bitu)(host-mem_base)>>12)) continue;
+		paging.tlb.read[page]=0;
+		paging.tlb.write[page]=0;
+		TLB_READHANDLER(page)=init_page_handler;
+		TLB_WRITEHANDLER(page)=init_page_handler;
+	}
+}
+
 void PAGING_MapPage(Bitu lin_page,Bitu phys_page) {
 	//LOG_MSG("[%8u] [@%8d] [MAPPAGE] Page: %x - Phys: %x", logcnt++, CPU_Cycles, lin_page, phys_page);
 	if (lin_page<LINK_START) {
 		paging.firstmb[lin_page]=phys_page;
-		paging.tlb.read[lin_page]=0;
-		paging.tlb.write[lin_page]=0;
-		paging.tlb.readhandler[lin_page]=init_page_handler;
-		paging.tlb.writehandler[lin_page]=init_page_handler;
+		PAGING_ResetTLBEntry(lin_page);
 	} else {
 		PAGING_LinkPage(lin_page,phys_page);
 	}
@@ -1456,28 +1491,29 @@ static void PAGING_LinkPageNew(Bitu lin_page, Bitu phys_page, Bitu linkmode, boo
 		LOG(LOG_PAGING,LOG_NORMAL)("Not enough paging links, resetting cache");
 		PAGING_ClearTLB();
 	}
+	PAGING_AllocTLBRegion(lin_page);
 	// re-use some of the unused bits in the phys_page variable
 	// needed in the exception handler and foiler so they can replace themselves appropriately
 	// bit31-30 ACMAP_
 	// bit29	dirty
-	// these bits are shifted off at the places paging.tlb.phys_page is read
-	paging.tlb.phys_page[lin_page]= phys_page | (linkmode<< 30) | (dirty? PHYSPAGE_DITRY:0);
+	// these bits are shifted off at the places the physical page table is read
+	TLB_PHYS_PAGE(lin_page)= phys_page | (linkmode<< 30) | (dirty? PHYSPAGE_DITRY:0);
 	switch(outcome) {
 	case ACMAP_RW:
 		// read
 		if (handler->flags & PFLAG_READABLE) paging.tlb.read[lin_page] = 
 			handler->GetHostReadPt(phys_page)-lin_base;
 		else paging.tlb.read[lin_page]=0;
-		paging.tlb.readhandler[lin_page]=handler;
+		TLB_READHANDLER(lin_page)=handler;
 
 		// write
 		if (dirty) { // in case it is already dirty we don't need to check
 			if (handler->flags & PFLAG_WRITEABLE) paging.tlb.write[lin_page] = 
 				handler->GetHostWritePt(phys_page)-lin_base;
 			else paging.tlb.write[lin_page]=0;
-			paging.tlb.writehandler[lin_page]=handler;
+			TLB_WRITEHANDLER(lin_page)=handler;
 		} else {
-			paging.tlb.writehandler[lin_page]= &normalcore_foiling_handler;
+			TLB_WRITEHANDLER(lin_page)= &normalcore_foiling_handler;
 			paging.tlb.write[lin_page]=0;
 		}
 		break;
@@ -1486,14 +1522,14 @@ static void PAGING_LinkPageNew(Bitu lin_page, Bitu phys_page, Bitu linkmode, boo
 		if (handler->flags & PFLAG_READABLE) paging.tlb.read[lin_page] = 
 			handler->GetHostReadPt(phys_page)-lin_base;
 		else paging.tlb.read[lin_page]=0;
-		paging.tlb.readhandler[lin_page]=handler;
+		TLB_READHANDLER(lin_page)=handler;
 		// exception
-		paging.tlb.writehandler[lin_page]= &normalcore_exception_handler;
+		TLB_WRITEHANDLER(lin_page)= &normalcore_exception_handler;
 		paging.tlb.write[lin_page]=0;
 		break;
 	case ACMAP_EE:
-		paging.tlb.readhandler[lin_page]= &normalcore_exception_handler;
-		paging.tlb.writehandler[lin_page]= &normalcore_exception_handler;
+		TLB_READHANDLER(lin_page)= &normalcore_exception_handler;
+		TLB_WRITEHANDLER(lin_page)= &normalcore_exception_handler;
 		paging.tlb.read[lin_page]=0;
 		paging.tlb.write[lin_page]=0;
 		break;
@@ -1527,16 +1563,17 @@ void PAGING_LinkPage(Bitu lin_page,Bitu phys_page) {
 		LOG(LOG_PAGING,LOG_NORMAL)("Not enough paging links, resetting cache");
 		PAGING_ClearTLB();
 	}
+	PAGING_AllocTLBRegion(lin_page);
 
-	paging.tlb.phys_page[lin_page]=phys_page;
+	TLB_PHYS_PAGE(lin_page)=phys_page;
 	if (handler->flags & PFLAG_READABLE) paging.tlb.read[lin_page]=handler->GetHostReadPt(phys_page)-lin_base;
 	else paging.tlb.read[lin_page]=0;
 	if (handler->flags & PFLAG_WRITEABLE) paging.tlb.write[lin_page]=handler->GetHostWritePt(phys_page)-lin_base;
 	else paging.tlb.write[lin_page]=0;
 
 	paging.links.entries[paging.links.used++]=lin_page;
-	paging.tlb.readhandler[lin_page]=handler;
-	paging.tlb.writehandler[lin_page]=handler;
+	TLB_READHANDLER(lin_page)=handler;
+	TLB_WRITEHANDLER(lin_page)=handler;
 }
 
 void PAGING_LinkPage_ReadOnly(Bitu lin_page,Bitu phys_page) {
@@ -1550,15 +1587,16 @@ void PAGING_LinkPage_ReadOnly(Bitu lin_page,Bitu phys_page) {
 		LOG(LOG_PAGING,LOG_NORMAL)("Not enough paging links, resetting cache");
 		PAGING_ClearTLB();
 	}
+	PAGING_AllocTLBRegion(lin_page);
 
-	paging.tlb.phys_page[lin_page]=phys_page;
+	TLB_PHYS_PAGE(lin_page)=phys_page;
 	if (handler->flags & PFLAG_READABLE) paging.tlb.read[lin_page]=handler->GetHostReadPt(phys_page)-lin_base;
 	else paging.tlb.read[lin_page]=0;
 	paging.tlb.write[lin_page]=0;
 
 	paging.links.entries[paging.links.used++]=lin_page;
-	paging.tlb.readhandler[lin_page]=handler;
-	paging.tlb.writehandler[lin_page]=&dyncore_init_page_handler_userro;
+	TLB_READHANDLER(lin_page)=handler;
+	TLB_WRITEHANDLER(lin_page)=&dyncore_init_page_handler_userro;
 }
 
 #else
@@ -1594,8 +1632,8 @@ void PAGING_SwitchCPL(bool isUser) {
 		// sv -> us: rw -> ee 
 		for(Bitu i = 0; i < paging.krw_links.used; i++) {
 			Bitu tlb_index = paging.krw_links.entries[i];
-			paging.tlb.readhandler[tlb_index] = &normalcore_exception_handler;
-			paging.tlb.writehandler[tlb_index] = &normalcore_exception_handler;
+			TLB_READHANDLER(tlb_index) = &normalcore_exception_handler;
+			TLB_WRITEHANDLER(tlb_index) = &normalcore_exception_handler;
 			paging.tlb.read[tlb_index] = 0;
 			paging.tlb.write[tlb_index] = 0;
 		}
@@ -1603,26 +1641,26 @@ void PAGING_SwitchCPL(bool isUser) {
 		// us -> sv: ee -> rw
 		for(Bitu i = 0; i < paging.krw_links.used; i++) {
 			Bitu tlb_index = paging.krw_links.entries[i];
-			Bitu phys_page = paging.tlb.phys_page[tlb_index];
+			Bitu phys_page = TLB_PHYS_PAGE(tlb_index);
 			Bitu lin_base = tlb_index << 12;
 			bool dirty = (phys_page & PHYSPAGE_DITRY)? true:false;
 			phys_page &= PHYSPAGE_ADDR;
 			PageHandler* handler = MEM_GetPageHandler(phys_page);
 			
 			// map read handler
-			paging.tlb.readhandler[tlb_index] = handler;
+			TLB_READHANDLER(tlb_index) = handler;
 			if (handler->flags&PFLAG_READABLE)
 				paging.tlb.read[tlb_index] = handler->GetHostReadPt(phys_page)-lin_base;
 			else paging.tlb.read[tlb_index] = 0;
 			
 			// map write handler
 			if (dirty) {
-				paging.tlb.writehandler[tlb_index] = handler;
+				TLB_WRITEHANDLER(tlb_index) = handler;
 				if (handler->flags&PFLAG_WRITEABLE)
 					paging.tlb.write[tlb_index] = handler->GetHostWritePt(phys_page)-lin_base;
 				else paging.tlb.write[tlb_index] = 0;
 			} else {
-				paging.tlb.writehandler[tlb_index] = &normalcore_foiling_handler;
+				TLB_WRITEHANDLER(tlb_index) = &normalcore_foiling_handler;
 				paging.tlb.write[tlb_index] = 0;
 			}
 		}
@@ -1635,7 +1673,7 @@ void PAGING_SwitchCPL(bool isUser) {
 			// sv -> us: re -> ee 
 			for(Bitu i = 0; i < paging.kr_links.used; i++) {
 				Bitu tlb_index = paging.kr_links.entries[i];
-				paging.tlb.readhandler[tlb_index] = &normalcore_exception_handler;
+				TLB_READHANDLER(tlb_index) = &normalcore_exception_handler;
 				paging.tlb.read[tlb_index] = 0;
 			}
 		} else {
@@ -1643,10 +1681,10 @@ void PAGING_SwitchCPL(bool isUser) {
 			for(Bitu i = 0; i < paging.kr_links.used; i++) {
 				Bitu tlb_index = paging.kr_links.entries[i];
 				Bitu lin_base = tlb_index << 12;
-				Bitu phys_page = paging.tlb.phys_page[tlb_index] & PHYSPAGE_ADDR;
+				Bitu phys_page = TLB_PHYS_PAGE(tlb_index) & PHYSPAGE_ADDR;
 				PageHandler* handler = MEM_GetPageHandler(phys_page);
 
-				paging.tlb.readhandler[tlb_index] = handler;
+				TLB_READHANDLER(tlb_index) = handler;
 				if (handler->flags&PFLAG_READABLE)
 					paging.tlb.read[tlb_index] = handler->GetHostReadPt(phys_page)-lin_base;
 				else paging.tlb.read[tlb_index] = 0;
@@ -1658,26 +1696,26 @@ void PAGING_SwitchCPL(bool isUser) {
 			// sv -> us: rw -> re 
 			for(Bitu i = 0; i < paging.ur_links.used; i++) {
 				Bitu tlb_index = paging.ur_links.entries[i];
-				paging.tlb.writehandler[tlb_index] = &normalcore_exception_handler;
+				TLB_WRITEHANDLER(tlb_index) = &normalcore_exception_handler;
 				paging.tlb.write[tlb_index] = 0;
 			}
 		} else {
 			// us -> sv: re -> rw
 			for(Bitu i = 0; i < paging.ur_links.used; i++) {
 				Bitu tlb_index = paging.ur_links.entries[i];
-				Bitu phys_page = paging.tlb.phys_page[tlb_index];
+				Bitu phys_page = TLB_PHYS_PAGE(tlb_index);
 				bool dirty = (phys_page & PHYSPAGE_DITRY)? true:false;
 				phys_page &= PHYSPAGE_ADDR;
 				PageHandler* handler = MEM_GetPageHandler(phys_page);
 
 				if (dirty) {
 					Bitu lin_base = tlb_index << 12;
-					paging.tlb.writehandler[tlb_index] = handler;
+					TLB_WRITEHANDLER(tlb_index) = handler;
 					if (handler->flags&PFLAG_WRITEABLE)
 						paging.tlb.write[tlb_index] = handler->GetHostWritePt(phys_page)-lin_base;
 					else paging.tlb.write[tlb_index] = 0;
 				} else {
-					paging.tlb.writehandler[tlb_index] = &normalcore_foiling_handler;
+					TLB_WRITEHANDLER(tlb_index) = &normalcore_foiling_handler;
 					paging.tlb.write[tlb_index] = 0;
 				}
 			}
@@ -1743,10 +1781,16 @@ void PAGING_OnChangeCore(void) {
 
 	if (prev_init_page_handler)
 	{
-		for (Bitu i=0;i<TLB_SIZE;i++)
+		for (Bitu r=0;r<=TLB_REGIONS;r++)
 		{
-			if (paging.tlb.readhandler[i]==prev_init_page_handler) paging.tlb.readhandler[i]=next_init_page_handler;
-			if (paging.tlb.writehandler[i]==prev_init_page_handler) paging.tlb.writehandler[i]=next_init_page_handler;
+			// visit the shared init region once at the end
+			tlb_region* region=(r<TLB_REGIONS ? paging.tlb.regions[r] : &tlb_init_region);
+			if (region==&tlb_init_region && r<TLB_REGIONS) continue;
+			for (Bitu i=0;i<TLB_REGION_SIZE;i++)
+			{
+				if (region->readhandler[i]==prev_init_page_handler) region->readhandler[i]=next_init_page_handler;
+				if (region->writehandler[i]==prev_init_page_handler) region->writehandler[i]=next_init_page_handler;
+			}
 		}
 	}
 	init_page_handler = next_init_page_handler;
@@ -1759,10 +1803,18 @@ DBP_SERIALIZE_SET_POINTER_LIST(CPU_DecoderPtr, Paging, PageFaultCore);
 
 void DBPSerialize_Paging(DBPArchive& ar)
 {
+	// Reset all linked pages, this needs to happen before an old save state overwrites the list of them
+	if (ar.mode == DBPArchive::MODE_LOAD)
+		PAGING_ClearTLB();
+
 	ar.Serialize(paging.cr3);
 	ar.Serialize(paging.cr2);
 	ar.Serialize(paging.base);
-	ar.SerializeSparse(paging.tlb.phys_page, sizeof(paging.tlb.phys_page));
+	// The physical page table is no longer stored, all pages get relinked after loading anyway.
+	// Keep it in the format as an empty sparse block and skip over the data in older save states.
+	Bit32u tlb_skip = 0, tlb_len = 0;
+	for (ar.Serialize(tlb_skip).Serialize(tlb_len); tlb_len; ar.Serialize(tlb_skip).Serialize(tlb_len))
+		ar.Discard(tlb_len);
 	if (ar.version < 5)
 		ar.SerializeSparse(paging.links.entries, sizeof(paging.links.entries));
 	ar.SerializeArray(paging.firstmb);
@@ -1774,17 +1826,6 @@ void DBPSerialize_Paging(DBPArchive& ar)
 	else // ar.version <= 3
 		ar.Discard(((Bit8u*)&pf_queue.entries[16] - (Bit8u*)&pf_queue));
 
-	if (ar.mode == DBPArchive::MODE_LOAD)
-	{
-		//PAGING_InitTLB();
-		memset(paging.tlb.read, 0, sizeof(paging.tlb.read));
-		memset(paging.tlb.write, 0, sizeof(paging.tlb.write));
-		for (Bitu i = 0; i != LINK_START; i++) {
-			paging.tlb.readhandler[i]=init_page_handler;
-			paging.tlb.writehandler[i]=init_page_handler;
-		}
-		PAGING_ClearTLB();
-	}
 	if (ar.mode == DBPArchive::MODE_ZERO)
 		pf_queue.used = 0;
 }
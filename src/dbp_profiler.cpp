@@ -0,0 +1,210 @@
+/*
+ *  Copyright (C) 2025 Bernhard Schelling
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <dbp_profiler.h>
+#include <callback.h>
+#include <inout.h>
+#include <pic.h>
+#include <dbp_serialize.h>
+#include <string.h> /* memset, strchr */
+#include <stdlib.h> /* calloc */
+#include <vector>
+#include <algorithm>
+#ifdef WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+bool DBP_Profiler::Active;
+
+struct DBP_ProfileStat { Bit64u time, period_time; Bit32u calls, period_calls; };
+struct DBP_ProfileEvent { Bitu handler; DBP_ProfileStat stat; };
+enum { DBP_PROFILE_MAX_EVENTS = 64 };
+static struct
+{
+	DBP_ProfileStat* ports; // IO_MAX reads followed by IO_MAX writes, only allocated once the profiler gets activated
+	DBP_ProfileStat callbacks[CB_MAX];
+	DBP_ProfileEvent events[DBP_PROFILE_MAX_EVENTS];
+	Bit64u period_kind[DBP_Profiler::_KIND_COUNT];
+} dbp_profile;
+
+Bit64u DBP_Profiler::Now()
+{
+	#ifdef WIN32
+	static double ns_per_tick;
+	LARGE_INTEGER c;
+	if (!ns_per_tick) { QueryPerformanceFrequency(&c); ns_per_tick = 1000000000.0 / (double)c.QuadPart; }
+	QueryPerformanceCounter(&c);
+	return (Bit64u)(c.QuadPart * ns_per_tick) | 1; // never 0
+	#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((Bit64u)ts.tv_sec * 1000000000 + (Bit64u)ts.tv_nsec) | 1; // never 0
+	#endif
+}
+
+void DBP_Profiler::SetActive(bool active)
+{
+	if (active == Active) return;
+	if (active)
+	{
+		// Handlers only write stats while Active is set so it is safe to reset them before setting it
+		if (!dbp_profile.ports) dbp_profile.ports = (DBP_ProfileStat*)calloc(IO_MAX * 2, sizeof(DBP_ProfileStat));
+		else memset(dbp_profile.ports, 0, IO_MAX * 2 * sizeof(DBP_ProfileStat));
+		memset(dbp_profile.callbacks, 0, sizeof(dbp_profile.callbacks));
+		memset(dbp_profile.events, 0, sizeof(dbp_profile.events));
+		memset(dbp_profile.period_kind, 0, sizeof(dbp_profile.period_kind));
+		if (!dbp_profile.ports) return;
+	}
+	Active = active;
+}
+
+void DBP_Profiler::Add(Kind kind, Bitu key, Bit64u start)
+{
+	Bit64u t = Now() - start;
+	DBP_ProfileStat* stat;
+	switch (kind)
+	{
+		case KIND_PIC:
+		{
+			// Linear probing, the handful of event handlers in use never fill the table
+			Bitu i = (key >> 4) & (DBP_PROFILE_MAX_EVENTS - 1);
+			for (Bitu n = 0; dbp_profile.events[i].handler != key; i = (i + 1) & (DBP_PROFILE_MAX_EVENTS - 1))
+			{
+				if (!dbp_profile.events[i].handler) { dbp_profile.events[i].handler = key; break; }
+				if (++n == DBP_PROFILE_MAX_EVENTS) return;
+			}
+			stat = &dbp_profile.events[i].stat;
+			break;
+		}
+		case KIND_IOREAD:  stat = &dbp_profile.ports[key]; break;
+		case KIND_IOWRITE: stat = &dbp_profile.ports[IO_MAX + key]; break;
+		case KIND_CALLBACK: stat = &dbp_profile.callbacks[key]; break;
+		default: return;
+	}
+	stat->period_time += t;
+	stat->period_calls++;
+	dbp_profile.period_kind[kind] += t;
+}
+
+// Event handlers are mostly static functions, their names come from the pointer lists used by DBPSerialize_PIC
+#define DBP_PROFILER_PIC_MODULES(X) X(VGA) X(VGA_Draw) X(SERIAL) X(CMOS) X(DISNEY) X(GUS) X(KEYBOARD) X(MPU401) X(SBLASTER) X(TIMER) X(MOUSE) \
+	X(unionDrive) X(IDEController) X(Voodoo) X(zipDrive) X(network)
+#define DBP_PROFILER_PIC_EXTERN(MODULE) DBP_SERIALIZE_EXTERN_POINTER_LIST(PIC_EventHandler, MODULE); DBP_SERIALIZE_EXTERN_POINTER_NAMES(PIC_EventHandler, MODULE);
+#define DBP_PROFILER_PIC_LIST(MODULE) { DBP_SERIALIZE_GET_POINTER_LIST(PIC_EventHandler, MODULE), DBP_SERIALIZE_GET_POINTER_NAMES(PIC_EventHandler, MODULE) },
+DBP_PROFILER_PIC_MODULES(DBP_PROFILER_PIC_EXTERN)
+
+static bool DBP_Profiler_PICName(char* buf, size_t bufsize, Bitu key)
+{
+	static const struct { PIC_EventHandler* ptrs; const char* names; } lists[] = { DBP_PROFILER_PIC_MODULES(DBP_PROFILER_PIC_LIST) };
+	for (const auto& l : lists)
+		for (Bitu i = 0; l.ptrs[i]; i++)
+		{
+			if ((Bitu)l.ptrs[i] != key) continue;
+			const char *name = l.names, *end;
+			while (i--) name = strchr(name, ',') + 1;
+			while (*name == ' ' || *name == '&') name++;
+			for (end = name; *end && *end != ',' && *end != ' '; end++) {}
+			snprintf(buf, bufsize, "%.*s", (int)(end - name), name);
+			return true;
+		}
+	return false;
+}
+
+static void DBP_Profiler_KeyName(char* buf, size_t bufsize, DBP_Profiler::Kind kind, Bitu key)
+{
+	const char* cbname;
+	switch (kind)
+	{
+		// Handlers missing from the pointer lists are printed relative to an exported symbol to be resolvable with nm on an unstripped build
+		case DBP_Profiler::KIND_PIC: if (!DBP_Profiler_PICName(buf, bufsize, key)) snprintf(buf, bufsize, "PIC_RunQueue%+lld", (long long)((char*)key - (char*)&PIC_RunQueue)); break;
+		case DBP_Profiler::KIND_IOREAD: case DBP_Profiler::KIND_IOWRITE: snprintf(buf, bufsize, "%04X", (unsigned)key); break;
+		case DBP_Profiler::KIND_CALLBACK: snprintf(buf, bufsize, "%s", ((cbname = CALLBACK_GetDescription(key)) != NULL ? cbname : "?")); break;
+		default: *buf = '\0'; break;
+	}
+}
+
+static void DBP_Profiler_EndPeriod(DBP_ProfileStat& s, Bit64u& max_time, Bitu& max_key, Bitu key)
+{
+	if (!s.period_calls) return;
+	if (s.period_time > max_time) { max_time = s.period_time; max_key = key; }
+	s.time += s.period_time;
+	s.calls += s.period_calls;
+	s.period_time = 0;
+	s.period_calls = 0;
+}
+
+static void DBP_Profiler_EndPeriods(Bit64u* max_time, Bitu* max_key)
+{
+	for (DBP_ProfileEvent& e : dbp_profile.events) DBP_Profiler_EndPeriod(e.stat, max_time[DBP_Profiler::KIND_PIC], max_key[DBP_Profiler::KIND_PIC], e.handler);
+	for (Bitu i = 0; i != IO_MAX; i++) DBP_Profiler_EndPeriod(dbp_profile.ports[i], max_time[DBP_Profiler::KIND_IOREAD], max_key[DBP_Profiler::KIND_IOREAD], i);
+	for (Bitu i = 0; i != IO_MAX; i++) DBP_Profiler_EndPeriod(dbp_profile.ports[IO_MAX + i], max_time[DBP_Profiler::KIND_IOWRITE], max_key[DBP_Profiler::KIND_IOWRITE], i);
+	for (Bitu i = 0; i != CB_MAX; i++) DBP_Profiler_EndPeriod(dbp_profile.callbacks[i], max_time[DBP_Profiler::KIND_CALLBACK], max_key[DBP_Profiler::KIND_CALLBACK], i);
+}
+
+void DBP_Profiler::TakePeriodStats(char* buf, size_t bufsize, Bit64u period_usec)
+{
+	if (!Active || !bufsize) { if (bufsize) *buf = '\0'; return; }
+	Bit64u max_time[_KIND_COUNT] = { 0 };
+	Bitu max_key[_KIND_COUNT] = { 0 };
+	DBP_Profiler_EndPeriods(max_time, max_key);
+
+	static const char* kind_names[_KIND_COUNT] = { "Eventos PIC", "Leitura E/S", "Escrita E/S", "Callbacks" };
+	const float to_percent = (period_usec ? 100.f / (float)(period_usec * 1000) : 0.f);
+	size_t len = 0;
+	*buf = '\0';
+	for (int k = 0; k != _KIND_COUNT && len < bufsize; k++)
+	{
+		char keyname[64];
+		DBP_Profiler_KeyName(keyname, sizeof(keyname), (Kind)k, max_key[k]);
+		int n = snprintf(buf + len, bufsize - len, (max_time[k] ? "%s%s: %4.1f%% (%s %4.1f%%)" : "%s%s: %4.1f%%"), (k ? ", " : "\n"),
+			kind_names[k], dbp_profile.period_kind[k] * to_percent, keyname, max_time[k] * to_percent);
+		if (n < 0) break;
+		len += (size_t)n;
+		dbp_profile.period_kind[k] = 0;
+	}
+}
+
+void DBP_Profiler::Dump(FILE* f)
+{
+	if (!dbp_profile.ports) return;
+	Bit64u max_time[_KIND_COUNT] = { 0 };
+	Bitu max_key[_KIND_COUNT] = { 0 };
+	DBP_Profiler_EndPeriods(max_time, max_key);
+
+	struct Entry { Kind kind; Bitu key; const DBP_ProfileStat* stat; bool operator<(const Entry& o) const { return stat->time > o.stat->time; } };
+	std::vector<Entry> entries;
+	for (const DBP_ProfileEvent& e : dbp_profile.events) if (e.stat.calls) entries.push_back({ KIND_PIC, e.handler, &e.stat });
+	for (Bitu i = 0; i != IO_MAX; i++) if (dbp_profile.ports[i].calls) entries.push_back({ KIND_IOREAD, i, &dbp_profile.ports[i] });
+	for (Bitu i = 0; i != IO_MAX; i++) if (dbp_profile.ports[IO_MAX + i].calls) entries.push_back({ KIND_IOWRITE, i, &dbp_profile.ports[IO_MAX + i] });
+	for (Bitu i = 0; i != CB_MAX; i++) if (dbp_profile.callbacks[i].calls) entries.push_back({ KIND_CALLBACK, i, &dbp_profile.callbacks[i] });
+	std::sort(entries.begin(), entries.end());
+
+	static const char* kind_names[_KIND_COUNT] = { "PIC event", "I/O read", "I/O write", "Callback" };
+	fprintf(f, "Host time spent in device emulation handlers (inclusive, nested handlers are counted in both)\n\n");
+	fprintf(f, "%-10s %-40s %12s %12s %10s\n", "Type", "Handler/Port/Callback", "Calls", "Total ms", "ns/call");
+	for (const Entry& e : entries)
+	{
+		char keyname[64];
+		DBP_Profiler_KeyName(keyname, sizeof(keyname), e.kind, e.key);
+		fprintf(f, "%-10s %-40s %12u %12.3f %10u\n", kind_names[e.kind], keyname, (unsigned)e.stat->calls,
+			e.stat->time / 1000000.0, (unsigned)(e.stat->time / e.stat->calls));
+	}
+}
@@ -17,9 +17,15 @@
  */
 
 #include <dbp_serialize.h>
+#include <dbp_threads.h>
+#include <mem.h>
+#include "dos/drives.h"
 #include <stdio.h>
 #include <string.h> /* memset, memcpy */
 #include <stdarg.h> /* va_list */
+#include <time.h> /* time */
+#include <vector>
+#include <deque>
 
 // Discard should only be called for MODE_LOAD archives which need to override this function
 DBPArchive& DBPArchive::Discard(size_t sz) { DBP_ASSERT(0); return *this; }
@@ -232,6 +238,12 @@ DBPArchive& DBPArchiveOptional::SerializeByte(void* p)
 
 size_t DBPArchiveOptional::GetOffset() { return outer->GetOffset(); }
 
+void DBPArchiveOptional::SerializeSparse(void* p, size_t sz)
+{
+	if (optionality == OPTIONAL_SERIALIZE) outer->SerializeSparse(p, sz);
+	else DBPArchive::SerializeSparse(p, sz);
+}
+
 DBPArchive& DBPArchiveReader::SerializeBytes(void* p, size_t sz)
 {
 	if (ptr + sz <= end) memcpy(p, ptr, sz); else had_error |= ERR_LAYOUT; ptr += sz; return *this;
@@ -247,6 +259,549 @@ DBPArchive& DBPArchiveZeroer::SerializeBytes(void* p, size_t sz)
 	memset(p, 0, sz); return *this;
 }
 
+enum { DBP_REWIND_PAGE = 4096, DBP_REWIND_DWORDS = DBP_REWIND_PAGE / 4 };
+
+// The guest RAM dirty page bitmap can only be used by whichever archive type last reset it
+// Once the frontend has a memory map it can write to guest RAM directly (cheats), then all pages are compared again
+bool dbp_memmaps_exposed;
+static const void* dbp_dirtypages_owner;
+static const Bit32u* DBP_GetDirtyPages(const void* owner) { return (dbp_dirtypages_owner == owner && !dbp_memmaps_exposed ? MemDirtyPages : NULL); }
+static void DBP_ResetDirtyPages(const void* owner) { if (dbp_memmaps_exposed) { dbp_dirtypages_owner = NULL; return; } MEM_ClearDirtyPages(); dbp_dirtypages_owner = owner; }
+
+static struct DBPRewindRing
+{
+	// Block 0 is the inline serialized data, all others are the blocks passed to SerializeSparse
+	struct Block { void* ptr; size_t size; std::vector<Bit32u> shadow; };
+	// The undo data of an entry holds the XOR deltas that turn the state of the next entry into this one
+	struct Entry { Bit64u seq; size_t len; std::vector<Bit8u> undo; };
+	std::vector<Block> blocks;
+	std::deque<Entry> entries;
+	std::vector<Bit8u> pending, scratch;
+	size_t budget, undo_bytes;
+	Bit64u next_seq;
+	Bit32u session;
+	bool invalid;
+
+	void DiffPage(Bit16u blk, Bit32u page, const Bit8u* mem, size_t len)
+	{
+		// Pages at the end of a block can be partial and blocks can be unaligned, so diff on an aligned copy
+		Bit32u cur[DBP_REWIND_DWORDS], *shadow = &blocks[blk].shadow[page * DBP_REWIND_DWORDS];
+		if (!memcmp(shadow, mem, len)) return;
+		memcpy(cur, mem, len);
+		memset((Bit8u*)cur + len, 0, DBP_REWIND_PAGE - len);
+
+		size_t o = pending.size();
+		pending.resize(o + 6);
+		memcpy(&pending[o], &blk, 2);
+		memcpy(&pending[o + 2], &page, 4);
+		for (Bit16u i = 0, zeros, lits; i != DBP_REWIND_DWORDS;)
+		{
+			for (zeros = 0; i != DBP_REWIND_DWORDS && cur[i] == shadow[i]; i++) zeros++;
+			for (lits = 0; i != DBP_REWIND_DWORDS && cur[i] != shadow[i]; i++) lits++;
+			o = pending.size();
+			pending.resize(o + 4 + lits * 4);
+			memcpy(&pending[o], &zeros, 2);
+			memcpy(&pending[o + 2], &lits, 2);
+			for (Bit16u j = i - lits; j != i; j++)
+			{
+				Bit32u x = (cur[j] ^ shadow[j]);
+				memcpy(&pending[o += 4], &x, 4);
+				shadow[j] = cur[j];
+			}
+		}
+	}
+
+	void DiffBlock(Bit16u blk, const void* ptr, size_t size, const Bit32u* dirty_pages = NULL)
+	{
+		const Bit8u* mem = (const Bit8u*)ptr;
+		for (Bit32u page = 0; size; page++, mem += DBP_REWIND_PAGE)
+		{
+			size_t len = (size < DBP_REWIND_PAGE ? size : DBP_REWIND_PAGE);
+			if (!dirty_pages || (dirty_pages[page>>5] & (1u<<(page&31))))
+				DiffPage(blk, page, mem, len);
+			size -= len;
+		}
+	}
+
+	void Undo(const std::vector<Bit8u>& undo)
+	{
+		for (const Bit8u *p = (undo.empty() ? NULL : &undo[0]), *pEnd = p + undo.size(); p != pEnd;)
+		{
+			Bit16u blk; Bit32u page;
+			memcpy(&blk, p, 2);
+			memcpy(&page, p + 2, 4);
+			p += 6;
+			Bit32u* shadow = &blocks[blk].shadow[page * DBP_REWIND_DWORDS];
+			for (Bit16u i = 0, zeros, lits; i != DBP_REWIND_DWORDS;)
+			{
+				memcpy(&zeros, p, 2);
+				memcpy(&lits, p + 2, 2);
+				for (p += 4, i += zeros; lits--; p += 4, i++)
+				{
+					Bit32u x;
+					memcpy(&x, p, 4);
+					shadow[i] ^= x;
+				}
+			}
+		}
+	}
+
+	void Clear(bool free_memory)
+	{
+		entries.clear();
+		undo_bytes = 0;
+		invalid = true;
+		if (!free_memory) return;
+		std::vector<Block>().swap(blocks);
+		std::vector<Bit8u>().swap(pending);
+		std::vector<Bit8u>().swap(scratch);
+	}
+} dbp_rewind;
+
+DBPArchiveRewind::DBPArchiveRewind(EMode _mode) : DBPArchive(_mode), offset(0), block(1)
+{
+	DBP_ASSERT(_mode == MODE_SAVE || _mode == MODE_LOAD);
+	if (_mode == MODE_SAVE) dbp_rewind.pending.clear();
+}
+
+DBPArchive& DBPArchiveRewind::SerializeBytes(void* p, size_t sz)
+{
+	if (mode == MODE_SAVE)
+	{
+		if (dbp_rewind.scratch.size() < offset + sz) dbp_rewind.scratch.resize((offset + sz) * 3 / 2);
+		memcpy(&dbp_rewind.scratch[offset], p, sz);
+	}
+	else if (offset + sz <= dbp_rewind.entries.back().len)
+		memcpy(p, (Bit8u*)&dbp_rewind.blocks[0].shadow[0] + offset, sz);
+	else
+		had_error |= ERR_LAYOUT;
+	offset += sz;
+	return *this;
+}
+
+DBPArchive& DBPArchiveRewind::Discard(size_t sz)
+{
+	if (offset + sz > dbp_rewind.entries.back().len) had_error |= ERR_LAYOUT;
+	offset += sz;
+	return *this;
+}
+
+void DBPArchiveRewind::SerializeSparse(void* p, size_t sz)
+{
+	DBPRewindRing& r = dbp_rewind;
+	Bit16u blk = (Bit16u)block++;
+	if (mode == MODE_LOAD)
+	{
+		if (blk >= r.blocks.size() || r.blocks[blk].ptr != p || r.blocks[blk].size != sz) { had_error |= ERR_LAYOUT; return; }
+		memcpy(p, &r.blocks[blk].shadow[0], sz);
+		if (p == MemBase) DBP_ResetDirtyPages(&r); // now identical to shadow copy
+		return;
+	}
+	if (r.blocks.size() <= blk) { r.blocks.resize(blk + 1); r.invalid = true; }
+	DBPRewindRing::Block& b = r.blocks[blk];
+	if (r.invalid || b.ptr != p || b.size != sz)
+	{
+		// Memory layout changed (or first state), store a new baseline
+		r.invalid = true;
+		b.ptr = p;
+		b.size = sz;
+		b.shadow.assign((sz + DBP_REWIND_PAGE - 1) / DBP_REWIND_PAGE * DBP_REWIND_DWORDS, 0);
+		memcpy(&b.shadow[0], p, sz);
+	}
+	else
+	{
+		// Only guest RAM pages which were written to since the last state need to be compared
+		r.DiffBlock(blk, p, sz, (p == MemBase ? DBP_GetDirtyPages(&r) : NULL));
+	}
+	if (p == MemBase) DBP_ResetDirtyPages(&r);
+}
+
+const Bit8u* DBPArchiveRewind::GetData()
+{
+	DBP_ASSERT(mode == MODE_SAVE);
+	return (dbp_rewind.scratch.empty() ? NULL : &dbp_rewind.scratch[0]);
+}
+
+bool DBPArchiveRewind::Commit(void* token, size_t token_size)
+{
+	DBPRewindRing& r = dbp_rewind;
+	DBP_ASSERT(mode == MODE_SAVE);
+	if (had_error || token_size < TOKEN_SIZE || !r.budget)
+	{
+		if (block != 1) r.Clear(false); // shadow copies were partially updated
+		return false;
+	}
+	if (r.blocks.size() != block) { r.blocks.resize(block); r.invalid = true; }
+
+	// The inline data is zero padded to full pages, it can grow over time but never shrinks
+	DBPRewindRing::Block& b0 = r.blocks[0];
+	size_t cap = (offset + DBP_REWIND_PAGE - 1) / DBP_REWIND_PAGE * DBP_REWIND_PAGE;
+	if (cap < b0.shadow.size() * 4) cap = b0.shadow.size() * 4;
+	if (r.scratch.size() < cap) r.scratch.resize(cap);
+	memset(&r.scratch[offset], 0, cap - offset);
+	b0.ptr = NULL;
+	b0.size = cap;
+	b0.shadow.resize(cap / 4, 0);
+
+	if (r.invalid || r.entries.empty())
+	{
+		r.Clear(false);
+		memcpy(&b0.shadow[0], &r.scratch[0], cap);
+		r.session = ((Bit32u)time(NULL) * 1103515245U) ^ (Bit32u)r.next_seq;
+		r.invalid = false;
+	}
+	else
+	{
+		r.DiffBlock(0, &r.scratch[0], cap);
+		std::vector<Bit8u>& undo = r.entries.back().undo;
+		undo.assign(r.pending.begin(), r.pending.end());
+		r.undo_bytes += undo.size();
+	}
+	r.pending.clear();
+
+	DBPRewindRing::Entry e;
+	e.seq = ++r.next_seq;
+	e.len = offset;
+	r.entries.push_back(e);
+
+	// Drop the oldest states until the undo deltas are within budget again (the shadow copies are needed regardless)
+	while (r.entries.size() > 1 && r.undo_bytes > r.budget)
+	{
+		r.undo_bytes -= r.entries.front().undo.size();
+		r.entries.pop_front();
+	}
+
+	Bit32u magic = 0x52504244; // 'DBPR'
+	memcpy((Bit8u*)token + 0, &magic, 4);
+	memcpy((Bit8u*)token + 4, &r.session, 4);
+	memcpy((Bit8u*)token + 8, &e.seq, 8);
+	memset((Bit8u*)token + TOKEN_SIZE, 0, token_size - TOKEN_SIZE);
+	return true;
+}
+
+bool DBPArchiveRewind::IsToken(const void* data, size_t size)
+{
+	return (size >= TOKEN_SIZE && !memcmp(data, "DBPR", 4));
+}
+
+bool DBPArchiveRewind::Restore(const void* token, size_t token_size)
+{
+	DBPRewindRing& r = dbp_rewind;
+	DBP_ASSERT(mode == MODE_LOAD);
+	Bit32u session; Bit64u seq;
+	if (!IsToken(token, token_size) || r.invalid || r.entries.empty()) return false;
+	memcpy(&session, (Bit8u*)token + 4, 4);
+	memcpy(&seq, (Bit8u*)token + 8, 8);
+	if (session != r.session) return false;
+
+	size_t idx = r.entries.size();
+	while (idx-- && r.entries[idx].seq > seq) {}
+	if (idx == (size_t)-1 || r.entries[idx].seq != seq) return false;
+
+	// Walk back from the newest state by applying the undo deltas onto the shadow copies
+	for (size_t i = r.entries.size() - 1; i-- > idx;)
+		r.Undo(r.entries[i].undo);
+	for (; r.entries.size() > idx + 1; r.entries.pop_back())
+		r.undo_bytes -= r.entries.back().undo.size();
+	r.undo_bytes -= r.entries.back().undo.size();
+	std::vector<Bit8u>().swap(r.entries.back().undo);
+	return true;
+}
+
+void DBPArchiveRewind::SetBudget(size_t bytes)
+{
+	if (!bytes) dbp_rewind.Clear(true);
+	dbp_rewind.budget = bytes;
+}
+
+void DBPArchiveRewind::Reset()
+{
+	dbp_rewind.Clear(false);
+}
+
+static struct DBPSnapshotBuffer
+{
+	// Sparse blocks are copied with the same 16 byte alignment as the source so the sparse encoding output stays identical
+	struct Block { void* ptr; size_t size, align; std::vector<Bit8u> copy; Bit8u* Data() { return &copy[align]; } };
+	// Positions in the inline data where a sparse block or a stream offset needs to be inserted
+	struct Op { size_t pos; Bit16u blk; };
+	enum { OP_OFFSET = 0xFFFF };
+	std::vector<Block> blocks;
+	std::vector<Bit8u> data;
+	std::vector<Op> ops;
+	size_t offset_query;
+} dbp_snapshot;
+
+DBPArchiveSnapshot::DBPArchiveSnapshot() : DBPArchive(MODE_SAVE), block(0)
+{
+	dbp_snapshot.data.clear();
+	dbp_snapshot.ops.clear();
+	dbp_snapshot.offset_query = (size_t)-1;
+}
+
+DBPArchive& DBPArchiveSnapshot::SerializeBytes(void* p, size_t sz)
+{
+	DBPSnapshotBuffer& s = dbp_snapshot;
+	size_t pos = s.data.size();
+	if (pos == s.offset_query && sz == sizeof(size_t))
+	{
+		// This stores the value just returned by GetOffset, it gets replaced by the real offset in Write
+		DBPSnapshotBuffer::Op op = { pos, (Bit16u)DBPSnapshotBuffer::OP_OFFSET };
+		s.ops.push_back(op);
+		s.offset_query = (size_t)-1;
+		return *this;
+	}
+	s.data.resize(pos + sz);
+	memcpy(&s.data[pos], p, sz);
+	return *this;
+}
+
+size_t DBPArchiveSnapshot::GetOffset()
+{
+	// The stream offset is unknown until the sparse blocks get encoded, see SerializeBytes
+	return (dbp_snapshot.offset_query = dbp_snapshot.data.size());
+}
+
+void DBPArchiveSnapshot::SerializeSparse(void* p, size_t sz)
+{
+	DBPSnapshotBuffer& s = dbp_snapshot;
+	Bit16u blk = (Bit16u)block++;
+	DBPSnapshotBuffer::Op op = { s.data.size(), blk };
+	s.ops.push_back(op);
+	if (s.blocks.size() <= blk) s.blocks.resize(blk + 1);
+	DBPSnapshotBuffer::Block& b = s.blocks[blk];
+	const Bit32u* dirty_pages = (p == MemBase ? DBP_GetDirtyPages(&s) : NULL);
+	if (b.ptr != p || b.size != sz)
+	{
+		b.ptr = p;
+		b.size = sz;
+		b.align = ((uintptr_t)p & 15);
+		b.copy.resize(sz + 16);
+		b.align = ((b.align - (uintptr_t)&b.copy[0]) & 15);
+		dirty_pages = NULL;
+	}
+	if (dirty_pages)
+	{
+		// Only copy the guest RAM pages which were written to since the last snapshot
+		for (Bit32u page = 0, pages = (Bit32u)(sz / DBP_REWIND_PAGE); page != pages; page++)
+			if (dirty_pages[page>>5] & (1u<<(page&31)))
+				memcpy(b.Data() + page * DBP_REWIND_PAGE, (Bit8u*)p + page * DBP_REWIND_PAGE, DBP_REWIND_PAGE);
+	}
+	else memcpy(b.Data(), p, sz);
+	if (p == MemBase) DBP_ResetDirtyPages(&s);
+}
+
+bool DBPArchiveSnapshot::Write(DBPArchive& ar)
+{
+	DBPSnapshotBuffer& s = dbp_snapshot;
+	DBP_ASSERT(ar.mode == MODE_SAVE);
+	if (had_error) return false;
+	size_t pos = 0, end = s.data.size();
+	for (const DBPSnapshotBuffer::Op& op : s.ops)
+	{
+		if (op.pos != pos) ar.SerializeBytes(&s.data[pos], op.pos - pos);
+		pos = op.pos;
+		if (op.blk == DBPSnapshotBuffer::OP_OFFSET) { size_t off = ar.GetOffset(); ar << off; }
+		else ar.SerializeSparse(s.blocks[op.blk].Data(), s.blocks[op.blk].size);
+	}
+	if (end != pos) ar.SerializeBytes(&s.data[pos], end - pos);
+	return !ar.had_error;
+}
+
+void DBPArchiveSnapshot::Free()
+{
+	std::vector<DBPSnapshotBuffer::Block>().swap(dbp_snapshot.blocks);
+	std::vector<Bit8u>().swap(dbp_snapshot.data);
+	std::vector<DBPSnapshotBuffer::Op>().swap(dbp_snapshot.ops);
+	if (dbp_dirtypages_owner == &dbp_snapshot) dbp_dirtypages_owner = NULL;
+}
+
+enum { DBP_DEFLATE_BLOCK = 512 * 1024, DBP_DEFLATE_STORED = 0x80000000, DBP_DEFLATE_HEADER = 16, DBP_DEFLATE_MAX_THREADS = 8 };
+
+static struct DBPDeflateState
+{
+	// Raw blocks have 4 extra bytes because the compressor reads ahead a bit
+	struct Block { std::vector<Bit8u> raw, comp; Bit32u comp_len; };
+	std::vector<Block> blocks;
+	std::vector<Bit8u> out;
+	size_t raw_size, comp_size;
+	Bit32u num_blocks, next_block, threads;
+	bool threads_active;
+	Mutex mtx;
+	Semaphore *sembegin, *semdone;
+	sdefl* workmem[DBP_DEFLATE_MAX_THREADS + 1];
+
+	void Work(Bit32u tnum)
+	{
+		for (;;)
+		{
+			mtx.Lock();
+			Bit32u i = next_block++;
+			mtx.Unlock();
+			if (i >= num_blocks) return;
+			Block& b = blocks[i];
+			Bit32u len = (Bit32u)(i == num_blocks - 1 ? raw_size - (size_t)i * DBP_DEFLATE_BLOCK : DBP_DEFLATE_BLOCK);
+			b.comp.resize(len + len / 8 + 16);
+			Bit32u n = zipDrive::Compress(&b.raw[0], len, &b.comp[0], workmem[tnum], 1); // fastest level, larger levels gain very little on memory dumps
+			b.comp_len = (n < len ? n : (len | DBP_DEFLATE_STORED));
+		}
+	}
+
+	void ShutdownThreads()
+	{
+		if (!threads_active) return;
+		threads_active = false;
+		for (Bit32u i = 0; i != threads; i++) sembegin[i].Post();
+		for (Bit32u i = 0; i != threads; i++) semdone[i].Wait();
+		delete [] sembegin;
+		delete [] semdone;
+	}
+} dbp_deflate;
+
+static Thread::RET_t THREAD_CC DBP_DeflateThread(void* p)
+{
+	for (Bit32u tnum = (Bit32u)(size_t)p; dbp_deflate.threads_active;)
+	{
+		dbp_deflate.sembegin[tnum].Wait();
+		if (dbp_deflate.threads_active)
+			dbp_deflate.Work(tnum);
+		dbp_deflate.semdone[tnum].Post();
+	}
+	return 0;
+}
+
+DBPArchiveDeflater::DBPArchiveDeflater() : DBPArchive(MODE_SAVE), offset(0) { }
+
+DBPArchive& DBPArchiveDeflater::SerializeBytes(void* p, size_t sz)
+{
+	DBPDeflateState& d = dbp_deflate;
+	for (const Bit8u* src = (const Bit8u*)p; sz;)
+	{
+		size_t blk = offset / DBP_DEFLATE_BLOCK, ofs = offset % DBP_DEFLATE_BLOCK, n = DBP_DEFLATE_BLOCK - ofs;
+		if (n > sz) n = sz;
+		if (d.blocks.size() <= blk) d.blocks.resize(blk + 1);
+		std::vector<Bit8u>& raw = d.blocks[blk].raw;
+		if (raw.size() != DBP_DEFLATE_BLOCK + 4) raw.resize(DBP_DEFLATE_BLOCK + 4);
+		memcpy(&raw[ofs], src, n);
+		src += n;
+		offset += n;
+		sz -= n;
+	}
+	return *this;
+}
+
+size_t DBPArchiveDeflater::Finish()
+{
+	DBPDeflateState& d = dbp_deflate;
+	d.raw_size = d.comp_size = 0;
+	if (had_error || offset > 0xFFFFFFFF) return 0;
+	d.raw_size = offset;
+	d.num_blocks = (Bit32u)((offset + DBP_DEFLATE_BLOCK - 1) / DBP_DEFLATE_BLOCK);
+	d.next_block = 0;
+
+	if (!d.threads_active && d.num_blocks > 1)
+	{
+		extern unsigned dbp_cpu_features_get_core_amount(void);
+		unsigned cores = dbp_cpu_features_get_core_amount();
+		d.threads = (cores <= (DBP_DEFLATE_MAX_THREADS+1) ? (cores ? cores - 1 : 0) : DBP_DEFLATE_MAX_THREADS);
+		if (d.threads)
+		{
+			d.threads_active = true;
+			d.sembegin = new Semaphore[d.threads];
+			d.semdone = new Semaphore[d.threads];
+			for (Bit32u i = 0; i != d.threads; i++) Thread::StartDetached(DBP_DeflateThread, (void*)(size_t)i);
+		}
+	}
+	Bit32u helpers = (d.threads_active ? (d.num_blocks - 1 < d.threads ? d.num_blocks - 1 : d.threads) : 0);
+	for (Bit32u i = 0; i != helpers; i++) d.sembegin[i].Post();
+	d.Work(DBP_DEFLATE_MAX_THREADS);
+	for (Bit32u i = 0; i != helpers; i++) d.semdone[i].Wait();
+
+	size_t total = DBP_DEFLATE_HEADER + d.num_blocks * 4;
+	for (Bit32u i = 0; i != d.num_blocks; i++) total += (d.blocks[i].comp_len & ~DBP_DEFLATE_STORED);
+	d.out.resize(total);
+	Bit32u hdr[4] = { 0x5A504244, (Bit32u)d.raw_size, (Bit32u)DBP_DEFLATE_BLOCK, d.num_blocks }; // 'DBPZ'
+	memcpy(&d.out[0], hdr, DBP_DEFLATE_HEADER);
+	Bit8u *table = &d.out[DBP_DEFLATE_HEADER], *p = table + d.num_blocks * 4;
+	for (Bit32u i = 0; i != d.num_blocks; i++)
+	{
+		const DBPDeflateState::Block& b = d.blocks[i];
+		Bit32u len = (b.comp_len & ~DBP_DEFLATE_STORED);
+		memcpy(table + i * 4, &b.comp_len, 4);
+		memcpy(p, ((b.comp_len & DBP_DEFLATE_STORED) ? &b.raw[0] : &b.comp[0]), len);
+		p += len;
+	}
+	return (d.comp_size = total);
+}
+
+const Bit8u* DBPArchiveDeflater::GetData()
+{
+	return (dbp_deflate.comp_size ? &dbp_deflate.out[0] : NULL);
+}
+
+void DBPArchiveDeflater::GetStats(size_t& raw_size, size_t& comp_size)
+{
+	raw_size = dbp_deflate.raw_size;
+	comp_size = dbp_deflate.comp_size;
+}
+
+void DBPArchiveDeflater::Free()
+{
+	DBPDeflateState& d = dbp_deflate;
+	d.ShutdownThreads();
+	for (sdefl*& workmem : d.workmem) zipDrive::FreeCompressMemory(workmem);
+	std::vector<DBPDeflateState::Block>().swap(d.blocks);
+	std::vector<Bit8u>().swap(d.out);
+	d.raw_size = d.comp_size = 0;
+}
+
+static std::vector<Bit8u> dbp_inflate_buf;
+
+DBPArchiveInflater::DBPArchiveInflater(const void* _ptr, size_t sz) : DBPArchive(MODE_LOAD), ptr((const Bit8u*)_ptr), end(ptr + sz), offset(0), raw_size(0), block_end(0), block(0)
+{
+	Bit32u hdr[4];
+	if (!IsCompressed(_ptr, sz)) { had_error |= ERR_LAYOUT; return; }
+	memcpy(hdr, ptr, DBP_DEFLATE_HEADER);
+	if (hdr[2] != DBP_DEFLATE_BLOCK || hdr[3] != (hdr[1] + DBP_DEFLATE_BLOCK - 1) / DBP_DEFLATE_BLOCK || sz < DBP_DEFLATE_HEADER + (size_t)hdr[3] * 4) { had_error |= ERR_LAYOUT; return; }
+	raw_size = hdr[1];
+	table = ptr + DBP_DEFLATE_HEADER;
+	ptr = table + hdr[3] * 4;
+	if (dbp_inflate_buf.size() != DBP_DEFLATE_BLOCK) dbp_inflate_buf.resize(DBP_DEFLATE_BLOCK);
+}
+
+DBPArchive& DBPArchiveInflater::SerializeBytes(void* p, size_t sz)
+{
+	for (Bit8u* trg = (Bit8u*)p; sz;)
+	{
+		if (offset == block_end)
+		{
+			// Inflate the next block
+			Bit32u comp_len, len = (Bit32u)(raw_size - block_end < DBP_DEFLATE_BLOCK ? raw_size - block_end : DBP_DEFLATE_BLOCK);
+			if (had_error || !len) { had_error |= ERR_LAYOUT; return *this; }
+			memcpy(&comp_len, table + block * 4, 4);
+			bool stored = !!(comp_len & DBP_DEFLATE_STORED);
+			comp_len &= ~DBP_DEFLATE_STORED;
+			if ((size_t)(end - ptr) < comp_len || (stored && comp_len != len)) { had_error |= ERR_LAYOUT; return *this; }
+			if (stored) memcpy(&dbp_inflate_buf[0], ptr, len);
+			else if (!zipDrive::Uncompress(ptr, comp_len, &dbp_inflate_buf[0], len)) { had_error |= ERR_LAYOUT; return *this; }
+			ptr += comp_len;
+			block_end += len;
+			block++;
+		}
+		size_t n = block_end - offset;
+		if (n > sz) n = sz;
+		if (trg) { memcpy(trg, &dbp_inflate_buf[offset % DBP_DEFLATE_BLOCK], n); trg += n; }
+		offset += n;
+		sz -= n;
+	}
+	return *this;
+}
+
+bool DBPArchiveInflater::IsCompressed(const void* data, size_t size)
+{
+	return (size >= DBP_DEFLATE_HEADER && !memcmp(data, "DBPZ", 4));
+}
+
 //#define DBP_SERIALIZE_PERF_TEST
 #ifdef DBP_SERIALIZE_PERF_TEST
 #ifdef _MSC_VER
@@ -270,14 +825,14 @@ void DBPSerialize_All(DBPArchive& ar, bool dos_running, bool game_running)
 	Bit64s from = __rdtsc();
 	#endif
 
-	ar.version = 8;
+	ar.version = 9;
 	if (ar.mode != DBPArchive::MODE_ZERO)
 	{
 		Bit32u magic = 0xD05B5747;
 		Bit8u invalid_state = (dos_running ? 0 : 1) | (game_running ? 0 : 2);
 		ar << magic << ar.version << invalid_state;
 		if (magic != 0xD05B5747) { ar.had_error = DBPArchive::ERR_LAYOUT; return; }
-		if (ar.version < 1 || ar.version > 8) { DBP_ASSERT(false); ar.had_error = DBPArchive::ERR_VERSION; return; }
+		if (ar.version < 1 || ar.version > 9) { DBP_ASSERT(false); ar.had_error = DBPArchive::ERR_VERSION; return; }
 		if (ar.mode == DBPArchive::MODE_LOAD || ar.mode == DBPArchive::MODE_SAVE)
 		{
 			if (!dos_running  || (invalid_state & 1)) { ar.had_error = DBPArchive::ERR_DOSNOTRUNNING; return; }
@@ -196,13 +196,22 @@ private:
 		~AudioFile();
 		bool read(Bit8u *buffer, int seek, int count);
 		int getLength();
+		#ifdef C_DBP_SUPPORT_CDROM_MOUNT_DOSFILE
+		struct AudioDecoder;
+		#endif
 	private:
 		AudioFile();
 		#ifdef C_DBP_SUPPORT_CDROM_MOUNT_DOSFILE
+		bool decode(Bit8u *buffer, int seek, int count);
 		Bit32u wave_start, audio_length, last_seek;
 		double audio_factor;
 		struct stb_vorbis *vorb;
 		std::vector<Bit8u> buffer_temp;
+		// Ogg Vorbis tracks get decoded by AudioDecoder on a background thread which reads the compressed data from blocks loaded by the emulation thread
+		std::vector<Bit8u*> data_blocks;
+		Bit32u data_ofs;
+		Bit8u* head; // first second of the track decoded in advance
+		Bit32u head_sectors, head_done;
 		#elif defined(C_SDL_SOUND)
 		Sound_Sample *sample;
 		int lastCount;
@@ -26,6 +26,7 @@
 #include <limits.h> //GCC 2.95
 #include <sstream>
 #include <vector>
+#include <algorithm>
 #include <sys/stat.h>
 #include "cdrom.h"
 #include "drives.h"
@@ -118,8 +119,245 @@ int CDROM_Interface_Image::BinaryFile::getLength()
 #ifdef C_DBP_SUPPORT_CDROM_MOUNT_DOSFILE
 
 #include "stb_vorbis.inl"
+#include "dbp_threads.h"
 
-CDROM_Interface_Image::AudioFile::AudioFile(const char *filename, bool &error, const char *relative_to) : TrackFile(filename, error, relative_to), last_seek(0), vorb(NULL)
+// Decodes Ogg Vorbis tracks on a background thread. The first second of every track is decoded in advance and the track being played
+// is decoded ahead into a ring of sectors. DOS files are not thread safe so the emulation thread loads the compressed data on request.
+struct CDROM_Interface_Image::AudioFile::AudioDecoder
+{
+	enum { SECTOR = RAW_SECTOR_SIZE, DATA_BLOCK = 64*1024, HEAD_SECTORS = 75, RING_SECTORS = 32, RING_KEEP = 8 };
+	static AudioDecoder Instance;
+
+	Mutex mutex;
+	Semaphore sem_work, sem_done;
+	std::vector<AudioFile*> files;
+	AudioFile *ring_file, *last_ring_file, *busy_file, *want_file, *removing;
+	Bit32u ring_pos, ring_first, ring_count, ring_gen, read_pos, want_block;
+	bool active, run;
+	Bit8u ring[RING_SECTORS][SECTOR];
+
+	void Add(AudioFile* f)
+	{
+		f->data_blocks.resize(f->dos_end / DATA_BLOCK + 1);
+		f->data_ofs = f->dos_ofs;
+		f->head_sectors = f->audio_length / SECTOR;
+		if (f->head_sectors > HEAD_SECTORS) f->head_sectors = HEAD_SECTORS;
+		f->head = (Bit8u*)malloc(f->head_sectors * SECTOR);
+		f->head_done = 0;
+		f->vorb->trkread = (bool(*)(void*,Bit8u*,int))&ReadData;
+		f->vorb->trkseek = (bool(*)(void*,int,int))&SeekData;
+		f->vorb->trktell = (Bit32u(*)(void*))&TellData;
+
+		mutex.Lock();
+		files.push_back(f);
+		mutex.Unlock();
+		if (active) { sem_work.Post(); return; }
+		active = run = true;
+		Thread::StartDetached(DecodeThread);
+	}
+
+	void Remove(AudioFile* f)
+	{
+		mutex.Lock();
+		files.erase(std::find(files.begin(), files.end(), f));
+		if (ring_file == f) ring_file = NULL;
+		if (last_ring_file == f) last_ring_file = NULL;
+		if (want_file == f) want_file = NULL;
+		for (removing = f; busy_file == f;) { mutex.Unlock(); sem_work.Post(); sem_done.Wait(); mutex.Lock(); }
+		removing = NULL;
+		bool stop = files.empty();
+		if (stop) run = false;
+		mutex.Unlock();
+		if (stop) for (sem_work.Post(); active;) sem_done.Wait();
+		for (Bit8u* block : f->data_blocks) free(block);
+		free(f->head);
+	}
+
+	// Called by the emulation thread to load compressed data requested by the decode thread
+	void Service()
+	{
+		mutex.Lock();
+		AudioFile* f = want_file;
+		Bit32u idx = want_block;
+		mutex.Unlock();
+		if (!f) return;
+		LoadBlock(f, idx);
+		mutex.Lock();
+		if (want_file == f && want_block == idx) want_file = NULL;
+		mutex.Unlock();
+		sem_work.Post();
+	}
+
+	// Only the emulation thread loads blocks so one missing now will still be missing after reading it
+	void LoadBlock(AudioFile* f, Bit32u idx)
+	{
+		if (idx >= f->data_blocks.size()) return;
+		mutex.Lock();
+		bool loaded = (f->data_blocks[idx] != NULL);
+		mutex.Unlock();
+		if (loaded) return;
+		Bit8u* block = (Bit8u*)malloc(DATA_BLOCK);
+		f->TrackFile::read(block, (int)(idx * DATA_BLOCK), DATA_BLOCK);
+		mutex.Lock();
+		f->data_blocks[idx] = block;
+		mutex.Unlock();
+	}
+
+	// Loads the compressed data around the estimated position of a seek target so the decoder does not need to ask for it block by block
+	void Prefetch(AudioFile* f, Bit32u seek)
+	{
+		Bit32u ofs = f->dos_ofs + (Bit32u)((Bit64u)(f->dos_end - f->dos_ofs) * seek / f->audio_length), idx = ofs / DATA_BLOCK;
+		LoadBlock(f, (idx ? idx - 1 : idx));
+		LoadBlock(f, idx);
+		LoadBlock(f, idx + 1);
+	}
+
+	void Restart(AudioFile* f, Bit32u pos)
+	{
+		ring_file = f;
+		ring_pos = read_pos = pos;
+		ring_first = ring_count = 0;
+		ring_gen++;
+	}
+
+	// Reads a sector for the emulation thread, if it has not been decoded yet wait for it so the output does not depend on host timing
+	void Read(AudioFile* f, Bit8u* buffer, Bit32u seek)
+	{
+		if (seek >= f->audio_length) { memset(buffer, 0, SECTOR); return; }
+		for (;;)
+		{
+			mutex.Lock();
+			bool in_ring = (ring_file == f && seek >= ring_pos && !((seek - ring_pos) % SECTOR));
+			if (in_ring && seek < ring_pos + ring_count * SECTOR)
+			{
+				memcpy(buffer, ring[(ring_first + (seek - ring_pos) / SECTOR) % RING_SECTORS], SECTOR);
+				read_pos = seek + SECTOR;
+				break;
+			}
+			if (!(seek % SECTOR) && seek / SECTOR < f->head_done)
+			{
+				// Continue decoding after the prepared sector unless the ring is already on its way there
+				memcpy(buffer, f->head + seek, SECTOR);
+				bool seeked = (!in_ring || seek + SECTOR >= ring_pos + RING_SECTORS * SECTOR);
+				if (seeked) Restart(f, seek + SECTOR);
+				read_pos = seek + SECTOR;
+				mutex.Unlock();
+				if (seeked) Prefetch(f, seek + SECTOR);
+				sem_work.Post();
+				return;
+			}
+			bool seeked = (!in_ring || seek >= ring_pos + RING_SECTORS * SECTOR);
+			if (seeked) Restart(f, seek);
+			mutex.Unlock();
+			if (seeked) Prefetch(f, seek);
+			sem_work.Post();
+			Service();
+			sem_done.Wait();
+		}
+		mutex.Unlock();
+		sem_work.Post();
+	}
+
+	static Thread::RET_t THREAD_CC DecodeThread(void*)
+	{
+		AudioDecoder& d = Instance;
+		Bit8u buf[SECTOR];
+		for (d.mutex.Lock(); d.run; d.mutex.Lock())
+		{
+			// Compressed data is only kept for the track being played and while preparing the start of a track
+			if (d.last_ring_file != d.ring_file)
+			{
+				if (d.last_ring_file && d.last_ring_file->head_done == d.last_ring_file->head_sectors) FreeData(d.last_ring_file);
+				d.last_ring_file = d.ring_file;
+			}
+
+			// Fill the ring first, once it is full drop the oldest sector if enough behind the read position are kept (for rewinding)
+			AudioFile* f = d.ring_file;
+			Bit32u pos = 0, gen = d.ring_gen;
+			bool head = false;
+			if (f) pos = d.ring_pos + d.ring_count * SECTOR;
+			if (f && (pos >= f->audio_length || (d.ring_count == RING_SECTORS && d.ring_pos + RING_KEEP * SECTOR >= d.read_pos))) f = NULL;
+			if (!f) for (AudioFile* it : d.files)
+				if (it != d.ring_file && it->head_done != it->head_sectors) { f = it; pos = it->head_done * SECTOR; head = true; break; }
+			d.busy_file = f;
+			d.mutex.Unlock();
+			if (!f) { d.sem_work.Wait(); continue; }
+
+			f->decode((head ? f->head + pos : buf), (int)pos, SECTOR);
+
+			d.mutex.Lock();
+			d.busy_file = NULL;
+			if (head)
+			{
+				if (++f->head_done == f->head_sectors && f != d.ring_file && f != d.removing) FreeData(f);
+			}
+			else if (gen == d.ring_gen)
+			{
+				if (d.ring_count == RING_SECTORS && d.ring_pos + RING_KEEP * SECTOR < d.read_pos)
+				{
+					d.ring_first = (d.ring_first + 1) % RING_SECTORS;
+					d.ring_pos += SECTOR;
+					d.ring_count--;
+				}
+				if (d.ring_count != RING_SECTORS)
+				{
+					memcpy(d.ring[(d.ring_first + d.ring_count) % RING_SECTORS], buf, SECTOR);
+					d.ring_count++;
+				}
+			}
+			d.mutex.Unlock();
+			d.sem_done.Post();
+		}
+		d.active = false;
+		d.mutex.Unlock();
+		d.sem_done.Post();
+		return 0;
+	}
+
+	static void FreeData(AudioFile* f)
+	{
+		for (Bit8u*& block : f->data_blocks) { free(block); block = NULL; }
+	}
+
+	static bool ReadData(AudioFile* trk, Bit8u *buffer, int count)
+	{
+		AudioDecoder& d = Instance;
+		while (count)
+		{
+			Bit32u ofs = trk->data_ofs, idx = ofs / DATA_BLOCK, n = DATA_BLOCK - (ofs % DATA_BLOCK);
+			if (ofs >= trk->dos_end) return false;
+			if (n > (Bit32u)count) n = (Bit32u)count;
+			if (n > trk->dos_end - ofs) n = trk->dos_end - ofs;
+			d.mutex.Lock();
+			Bit8u* block = trk->data_blocks[idx];
+			bool abort = (d.removing == trk);
+			if (!block && !abort) { d.want_file = trk; d.want_block = idx; }
+			d.mutex.Unlock();
+			if (abort) return false;
+			if (!block) { d.sem_done.Post(); d.sem_work.Wait(); continue; }
+			memcpy(buffer, block + (ofs % DATA_BLOCK), n);
+			buffer += n;
+			count -= (int)n;
+			trk->data_ofs = ofs + n;
+		}
+		return true;
+	}
+
+	static bool SeekData(AudioFile* trk, int pos, int dos_seek_mode)
+	{
+		trk->data_ofs = (Bit32u)pos + (dos_seek_mode == DOS_SEEK_CUR ? trk->data_ofs : dos_seek_mode == DOS_SEEK_END ? trk->dos_end : 0);
+		return true;
+	}
+
+	static Bit32u TellData(AudioFile* trk)
+	{
+		return trk->data_ofs;
+	}
+};
+
+CDROM_Interface_Image::AudioFile::AudioDecoder CDROM_Interface_Image::AudioFile::AudioDecoder::Instance;
+
+CDROM_Interface_Image::AudioFile::AudioFile(const char *filename, bool &error, const char *relative_to) : TrackFile(filename, error, relative_to), last_seek(0), vorb(NULL), head(NULL)
 {
 	if (error) return;
 
@@ -180,16 +418,26 @@ CDROM_Interface_Image::AudioFile::AudioFile(const char *filename, bool &error, c
 
 	if (audio_factor != 1.0) buffer_temp.resize((size_t)(16 + RAW_SECTOR_SIZE * audio_factor)); // alloc temp buffer for resampling
 	audio_length = (Bit32u)(audio_length / audio_factor / (double)(RAW_SECTOR_SIZE) + .4999) * (Bit32u)(RAW_SECTOR_SIZE); // fix and round to RAW_SECTOR_SIZE
+	if (vorb) AudioDecoder::Instance.Add(this);
 	error = false;
 }
 
 CDROM_Interface_Image::AudioFile::~AudioFile()
 {
-	if (vorb)
-		stb_vorbis_close(vorb);
+	if (!vorb) return;
+	if (head) AudioDecoder::Instance.Remove(this);
+	stb_vorbis_close(vorb);
 }
 
 bool CDROM_Interface_Image::AudioFile::read(Bit8u *buffer, int seek, int count)
+{
+	if (!vorb) return decode(buffer, seek, count);
+	DBP_ASSERT(count == RAW_SECTOR_SIZE);
+	AudioDecoder::Instance.Read(this, buffer, (Bit32u)seek);
+	return true;
+}
+
+bool CDROM_Interface_Image::AudioFile::decode(Bit8u *buffer, int seek, int count)
 {
 	DBP_ASSERT(count == RAW_SECTOR_SIZE);
 	int count_org = count;
@@ -646,6 +894,9 @@ void CDROM_Interface_Image::CDAudioCallBack(Bitu len)
 {
 	len *= 4;       // 16 bit, stereo
 	if (!len) return;
+#ifdef C_DBP_SUPPORT_CDROM_MOUNT_DOSFILE
+	if (AudioFile::AudioDecoder::Instance.active) AudioFile::AudioDecoder::Instance.Service();
+#endif
 	if (!player.isPlaying || player.isPaused) {
 		player.channel->AddSilence();
 		return;
@@ -21,8 +21,14 @@
 #include "drives.h"
 #include "inout.h"
 #include "pic.h"
+#include "dbp_threads.h"
 
 #include <vector>
+#if defined(WIN32)
+#include <io.h>
+#elif (C_HAVE_MPROTECT)
+#include <sys/mman.h>
+#endif
 
 struct miniz
 {
@@ -1057,27 +1063,56 @@ struct Zip_Archive
 	Bit64u ofs;
 	Bit64u size;
 	bool enable_crc_check;
+	Mutex* lock; // only set while the background indexer is reading from other threads
+	const Bit8u* map; // entire archive mapped into memory when opened from a host file
 
-	Zip_Archive(DOS_File* _zip, bool _enable_crc_check) : zip(_zip), enable_crc_check(_enable_crc_check)
+	Zip_Archive(DOS_File* _zip, bool _enable_crc_check) : zip(_zip), enable_crc_check(_enable_crc_check), lock(NULL), map(NULL)
 	{
 		zip->AddRef();
 		size = 0;
 		bool can_seek = zip->Seek64(&size, DOS_SEEK_END);
 		ofs = size;
 		DBP_ASSERT(can_seek);
+		Map();
 	}
 	
 	~Zip_Archive()
 	{
+		if (map)
+		{
+			#if defined(WIN32)
+			UnmapViewOfFile(map);
+			#elif (C_HAVE_MPROTECT)
+			munmap((void*)map, (size_t)size);
+			#endif
+		}
 		if (!zip) return;
 		if (zip->IsOpen()) zip->Close();
 		if (zip->RemoveRef() <= 0) delete zip;
 	}
 
+	void Map()
+	{
+		// Keep the address space usage reasonable on 32-bit platforms, reads fall back to the file otherwise
+		rawFile* raw = dynamic_cast<rawFile*>(zip);
+		if (!raw || !size || size > (sizeof(void*) > 4 ? (Bit64u)0x10000000000 : (Bit64u)0x20000000)) return;
+		#if defined(WIN32)
+		HANDLE mapping = CreateFileMappingA((HANDLE)_get_osfhandle(_fileno(raw->f)), NULL, PAGE_READONLY, 0, 0, NULL);
+		if (!mapping) return;
+		map = (const Bit8u*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping); // the view keeps the mapping alive
+		#elif (C_HAVE_MPROTECT)
+		void* p = mmap(NULL, (size_t)size, PROT_READ, MAP_SHARED, fileno(raw->f), 0);
+		if (p != MAP_FAILED) map = (const Bit8u*)p;
+		#endif
+	}
+
 	Bit32u Read(Bit64u seek_ofs, void *pBuf, Bit32u n)
 	{
 		if (seek_ofs >= size) n = 0;
 		else if ((Bit64u)n > (size - seek_ofs)) n = (Bit32u)(size - seek_ofs);
+		if (map) { memcpy(pBuf, map + seek_ofs, n); return n; }
+		if (lock) lock->Lock();
 		if (seek_ofs != ofs)
 		{
 			zip->Seek64(&seek_ofs, DOS_SEEK_SET);
@@ -1092,8 +1127,16 @@ struct Zip_Archive
 			pOut += sz;
 		}
 		ofs += n;
+		if (lock) lock->Unlock();
 		return n;
 	}
+
+	// Get n bytes at seek_ofs, pointing directly into the mapped archive when possible, otherwise read into buf
+	const Bit8u* Fetch(Bit64u seek_ofs, Bit8u* buf, Bit32u n)
+	{
+		if (map) return (seek_ofs + n <= size ? map + seek_ofs : NULL);
+		return (Read(seek_ofs, buf, n) == n ? buf : NULL);
+	}
 };
 
 struct ZIP_Unpacker
@@ -1136,9 +1179,10 @@ struct Zip_File : Zip_Entry
 	Bit8u bit_flags, method, have_pic;
 	Bit64u data_ofs;
 	ZIP_Unpacker* unpacker;
+	struct Zip_IndexJob* index_job;
 
 	Zip_File(Bit16u _attr, const char* filename, Bit16u _date, Bit16u _time, Bit64u _data_ofs, Bit32u _decomp_size, Bit32u _comp_size, Bit32u _crc, Bit8u _bit_flags, Bit8u _method)
-		: Zip_Entry(_attr, filename, _date, _time), decomp_size(_decomp_size), comp_size(_comp_size), crc(_crc), refs(0), ofs_past_header(0), bit_flags(_bit_flags), method(_method), have_pic(0), data_ofs(_data_ofs), unpacker(NULL) {}
+		: Zip_Entry(_attr, filename, _date, _time), decomp_size(_decomp_size), comp_size(_comp_size), crc(_crc), refs(0), ofs_past_header(0), bit_flags(_bit_flags), method(_method), have_pic(0), data_ofs(_data_ofs), unpacker(NULL), index_job(NULL) {}
 
 	~Zip_File()
 	{
@@ -1150,6 +1194,108 @@ struct Zip_File : Zip_Entry
 	static void PICHandler(Bitu implPtr);
 };
 
+struct Zip_BlockCache
+{
+	// Drive-wide LRU cache of decompressed blocks so files that get reopened or read back and forth don't need to be inflated again
+	enum { BLOCK_SIZE = miniz::TINFL_LZ_DICT_SIZE, NONE = 0xFFFFFFFF };
+	struct Block { const Zip_File* f; Bit32u idx, prev, next; Bit8u* data; };
+	struct Key { const Zip_File* f; Bit32u idx; };
+	std::vector<Block> blocks;
+	ValueEqualHashMap<Bit32u> map;
+	Bit32u head, tail; // most and least recently used
+	Bit32u used, hits, misses;
+	static Bit32u budget; // per drive
+	static std::vector<Zip_BlockCache*> all; // for the stats of all mounted drives
+	static Mutex all_lock;
+
+	Zip_BlockCache() : head(NONE), tail(NONE), used(0), hits(0), misses(0)
+	{
+		all_lock.Lock();
+		all.push_back(this);
+		all_lock.Unlock();
+	}
+
+	~Zip_BlockCache()
+	{
+		Clear();
+		all_lock.Lock();
+		for (size_t i = 0; i != all.size(); i++)
+			if (all[i] == this) { all.erase(all.begin() + i); break; }
+		all_lock.Unlock();
+	}
+
+	void Clear()
+	{
+		for (Block& b : blocks) free(b.data);
+		used -= (Bit32u)blocks.size() * BLOCK_SIZE;
+		blocks.clear();
+		map.Clear();
+		head = tail = NONE;
+	}
+
+	static Bit32u Hash(const Zip_File* f, Bit32u idx) { Bit32u h = (Bit32u)((size_t)f >> 4) * 0x9E3779B1 ^ idx * 0x85EBCA6B; return h ^ (h >> 15); }
+	static bool Equal(const std::vector<Block>& blocks, Bit32u slot, const Key& k) { return (blocks[slot].f == k.f && blocks[slot].idx == k.idx); }
+
+	void Unlink(Bit32u slot)
+	{
+		Block& b = blocks[slot];
+		if (b.prev != NONE) blocks[b.prev].next = b.next; else head = b.next;
+		if (b.next != NONE) blocks[b.next].prev = b.prev; else tail = b.prev;
+	}
+
+	void LinkHead(Bit32u slot)
+	{
+		Block& b = blocks[slot];
+		b.prev = NONE;
+		b.next = head;
+		if (head != NONE) blocks[head].prev = slot; else tail = slot;
+		head = slot;
+	}
+
+	const Bit8u* Get(const Zip_File& f, Bit32u idx)
+	{
+		const Key k = { &f, idx };
+		Bit32u* slot = (blocks.size() ? map.Get(Hash(&f, idx), Equal, blocks, k) : NULL);
+		if (!slot) { misses++; return NULL; }
+		hits++;
+		if (*slot != head) { Unlink(*slot); LinkHead(*slot); }
+		return blocks[*slot].data;
+	}
+
+	void Put(const Zip_File& f, Bit32u idx, const Bit8u* data, Bit32u size)
+	{
+		const Key k = { &f, idx };
+		Bit32u hash = Hash(&f, idx), max_blocks = budget / BLOCK_SIZE, slot;
+		if (blocks.size() > max_blocks) Clear(); // budget was lowered
+		if (!max_blocks || map.Get(hash, Equal, blocks, k)) return;
+		if (blocks.size() < max_blocks)
+		{
+			slot = (Bit32u)blocks.size();
+			blocks.emplace_back();
+			blocks[slot].data = (Bit8u*)malloc(BLOCK_SIZE);
+			used += BLOCK_SIZE;
+		}
+		else
+		{
+			slot = tail;
+			Block& b = blocks[slot];
+			const Key old = { b.f, b.idx };
+			map.Remove(Hash(b.f, b.idx), Equal, blocks, old);
+			Unlink(slot);
+		}
+		Block& b = blocks[slot];
+		b.f = &f;
+		b.idx = idx;
+		memcpy(b.data, data, size);
+		LinkHead(slot);
+		map.Put(hash, Equal, blocks, k, slot);
+	}
+};
+
+Bit32u Zip_BlockCache::budget = 32*1024*1024;
+std::vector<Zip_BlockCache*> Zip_BlockCache::all;
+Mutex Zip_BlockCache::all_lock;
+
 struct Zip_StoredUnpacker : ZIP_Unpacker
 {
 	Zip_Archive& archive;
@@ -1243,6 +1389,7 @@ struct Zip_DeflateMemoryUnpacker : Zip_MemoryUnpacker
 		Bit64u ofs = f.data_ofs;
 		Bit32u out_buf_ofs = 0, read_buf_avail = 0, read_buf_ofs = 0, comp_remaining = f.comp_size;
 		Bit8u read_buf[miniz::MZ_ZIP_MAX_IO_BUF_SIZE], *out_data = &mem_data[0];
+		const Bit8u* read_src = NULL;
 		miniz::tinfl_init(&inflator);
 
 		for (miniz::tinfl_status status = miniz::TINFL_STATUS_NEEDS_MORE_INPUT; status == miniz::TINFL_STATUS_NEEDS_MORE_INPUT || status == miniz::TINFL_STATUS_HAS_MORE_OUTPUT;)
@@ -1250,7 +1397,7 @@ struct Zip_DeflateMemoryUnpacker : Zip_MemoryUnpacker
 			if (!read_buf_avail)
 			{
 				read_buf_avail = (comp_remaining < miniz::MZ_ZIP_MAX_IO_BUF_SIZE ? comp_remaining : miniz::MZ_ZIP_MAX_IO_BUF_SIZE);
-				if (archive.Read(ofs, read_buf, read_buf_avail) != read_buf_avail)
+				if (!(read_src = archive.Fetch(ofs, read_buf, read_buf_avail)))
 					break;
 				ofs += read_buf_avail;
 				comp_remaining -= read_buf_avail;
@@ -1259,7 +1406,7 @@ struct Zip_DeflateMemoryUnpacker : Zip_MemoryUnpacker
 			Bit32u out_buf_size = f.decomp_size - out_buf_ofs;
 			Bit8u *pWrite_buf_cur = out_data + out_buf_ofs;
 			Bit32u in_buf_size = read_buf_avail;
-			status = miniz::tinfl_decompress(&inflator, read_buf + read_buf_ofs, &in_buf_size, out_data, pWrite_buf_cur, &out_buf_size, miniz::TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF | (comp_remaining ? miniz::TINFL_FLAG_HAS_MORE_INPUT : 0));
+			status = miniz::tinfl_decompress(&inflator, read_src + read_buf_ofs, &in_buf_size, out_data, pWrite_buf_cur, &out_buf_size, miniz::TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF | (comp_remaining ? miniz::TINFL_FLAG_HAS_MORE_INPUT : 0));
 			read_buf_avail -= in_buf_size;
 			read_buf_ofs += in_buf_size;
 			out_buf_ofs += out_buf_size;
@@ -1272,12 +1419,14 @@ struct Zip_DeflateMemoryUnpacker : Zip_MemoryUnpacker
 struct Zip_DeflateUnpacker : ZIP_Unpacker
 {
 	Zip_Archive& archive;
+	Zip_BlockCache& cache;
 	miniz::tinfl_decompressor inflator;
 	Bit64u ofs;
 	Bit64u ofs_last_read;
 	Bit32u out_buf_ofs;
 	Bit32u read_buf_avail;
 	Bit32u read_buf_ofs;
+	const Bit8u* read_src;
 	Bit32u comp_remaining;
 	Bit32u crc_run, crc_ofs, crc_failed;
 
@@ -1304,15 +1453,11 @@ struct Zip_DeflateUnpacker : ZIP_Unpacker
 	enum { SEEK_CURSOR_MAX_DEFL = 128 + (sizeof(SeekCursor) + 9) / 10 * 11, SEEK_CACHE_CURSOR_NEED = 50, SEEK_CACHE_CURSOR_STEPS = 20 };
 	struct SeekCache { zipDrive* drv; std::string path; Bit32u count; } * seek_cache;
 
-	Zip_DeflateUnpacker(Zip_Archive& _archive, const Zip_File& f, zipDrive* drv, const char* path) : archive(_archive), crc_run(0), crc_ofs((Bit32u)-1), crc_failed(0), seek_cache(NULL)
+	Zip_DeflateUnpacker(Zip_Archive& _archive, Zip_BlockCache& _cache, const Zip_File& f, zipDrive* drv, const char* path) : archive(_archive), cache(_cache), crc_run(0), crc_ofs((Bit32u)-1), crc_failed(0), seek_cache(NULL)
 	{
 		//printf("[%s] OPENED FILE!\n", f.name);
 		DBP_ASSERT(f.ofs_past_header);
-		cursor_block =
-			  f.decomp_size > (50*1024*1024) ? (1024*1024)  // 50~   MB, 50~   cursors
-			: f.decomp_size > (30*1024*1024) ? ( 768*1024)  // 30~50 MB, 40~77 cursors
-			: f.decomp_size > (12*1024*1024) ? ( 384*1024)  // 12~30 MB, 32~80 cursors
-			:                                  ( 256*1024); //  0~12 MB,  2~48 cursors
+		cursor_block = GetCursorBlock(f.decomp_size);
 		Bit32u cursor_count = (f.decomp_size + (cursor_block - 1)) / cursor_block;
 		cursors = (SeekCursor*)calloc(cursor_count, sizeof(SeekCursor));
 		Reset(f);
@@ -1356,6 +1501,8 @@ struct Zip_DeflateUnpacker : ZIP_Unpacker
 					Drives[drive_idx]->FileUnlink((char*)seek_cache->path.c_str());
 					seek_cache->count = 0;
 				}
+				if (seek_cache->count && f.index_job)
+					AbortIndexJob(f); // already got cursors from the seek cache file
 			}
 		}
 	}
@@ -1366,6 +1513,38 @@ struct Zip_DeflateUnpacker : ZIP_Unpacker
 		free(cursors);
 	}
 
+	static Bit32u GetCursorBlock(Bit32u decomp_size)
+	{
+		return
+			  decomp_size > (50*1024*1024) ? (1024*1024)  // 50~   MB, 50~   cursors
+			: decomp_size > (30*1024*1024) ? ( 768*1024)  // 30~50 MB, 40~77 cursors
+			: decomp_size > (12*1024*1024) ? ( 384*1024)  // 12~30 MB, 32~80 cursors
+			:                                ( 256*1024); //  0~12 MB,  2~48 cursors
+	}
+
+	static bool WantCursor(const SeekCursor& c, Bit32u idx, Bit32u out_buf_ofs, Bit32u cursor_block)
+	{
+		// Gear cursors toward the middle of the block to accommodate forward and backward seeking as well as possible
+		return (!c.cursor_out || (out_buf_ofs > c.cursor_out + 120*1024 && out_buf_ofs < idx*cursor_block + cursor_block/2 + 70*1024));
+	}
+
+	static void StoreCursor(SeekCursor& c, const miniz::tinfl_decompressor& inflator, Bit64u cursor_in, Bit32u cursor_out, const Bit8u* write_buf)
+	{
+		c.cursor_in = cursor_in;
+		c.cursor_out = cursor_out;
+		c.m_num_bits                = inflator.m_num_bits;
+		c.m_bit_buf                 = inflator.m_bit_buf;
+		c.m_dist                    = inflator.m_dist;
+		c.m_counter                 = inflator.m_counter;
+		c.m_num_extra               = inflator.m_num_extra;
+		c.m_dist_from_out_buf_start = inflator.m_dist_from_out_buf_start;
+		memcpy(c.write_buf, write_buf, WRITE_BLOCK);
+	}
+
+	static void RunIndexJob(Zip_Archive& archive, Mutex& lock, struct Zip_IndexJob& job);
+	static void AbortIndexJob(const Zip_File& f);
+	void SyncIndex(const Zip_File& f);
+
 	void Reset(const Zip_File& f)
 	{
 		miniz::tinfl_init(&inflator);
@@ -1377,10 +1556,24 @@ struct Zip_DeflateUnpacker : ZIP_Unpacker
 	Bit32u Read(const Zip_File& f, Bit32u seek_ofs, void *res_buf, Bit32u res_n)
 	{
 		if (crc_failed) return 0;
+		if (f.index_job) SyncIndex(f);
 		Bit32u want_from = seek_ofs, want_to = seek_ofs + res_n, last_idx = (Bit32u)-1, slowload_num, slowload_tick;
 		DBP_ASSERT(want_to <= f.decomp_size);
 
+		// While the CRC is being checked, data past the checked part must come from the inflator instead of the block cache
 		Bit32u have_from = ((out_buf_ofs ? out_buf_ofs - 1 : 0) & ~(WRITE_BLOCK-1));
+		Bit32u cache_end = (crc_ofs < f.decomp_size ? (crc_ofs & ~(WRITE_BLOCK-1)) : f.decomp_size);
+		for (Bit32u n; (want_from < have_from || want_from >= out_buf_ofs) && want_from < cache_end; want_from += n)
+		{
+			// Data outside of the current window might still be in the block cache
+			DBP_STATIC_ASSERT((Bit32u)Zip_BlockCache::BLOCK_SIZE == (Bit32u)WRITE_BLOCK);
+			const Bit8u* blk = cache.Get(f, want_from / WRITE_BLOCK);
+			if (!blk) break;
+			n = WRITE_BLOCK - (want_from & (WRITE_BLOCK-1));
+			if (n > want_to - want_from) n = want_to - want_from;
+			memcpy((Bit8u*)res_buf + (want_from - seek_ofs), blk + (want_from & (WRITE_BLOCK-1)), n);
+			if (want_from + n == want_to) return res_n;
+		}
 		if (want_from < have_from || want_from > out_buf_ofs)
 		{
 			for (Bit32u idx = (want_from / cursor_block);; idx--)
@@ -1410,7 +1603,7 @@ struct Zip_DeflateUnpacker : ZIP_Unpacker
 			}
 		}
 
-		Bit8u* p_res = (Bit8u*)res_buf;
+		Bit8u* p_res = (Bit8u*)res_buf + (want_from - seek_ofs);
 		for (miniz::tinfl_status status = miniz::TINFL_STATUS_NEEDS_MORE_INPUT; status == miniz::TINFL_STATUS_NEEDS_MORE_INPUT || status == miniz::TINFL_STATUS_HAS_MORE_OUTPUT || status == miniz::TINFL_STATUS_DONE;)
 		{
 			if (out_buf_ofs > want_from)
@@ -1429,7 +1622,7 @@ struct Zip_DeflateUnpacker : ZIP_Unpacker
 			if (!read_buf_avail)
 			{
 				read_buf_avail = (comp_remaining < READ_BLOCK ? comp_remaining : READ_BLOCK);
-				if (archive.Read(ofs, read_buf, read_buf_avail) != read_buf_avail)
+				if (!(read_src = archive.Fetch(ofs, read_buf, read_buf_avail)))
 					break;
 				ofs_last_read = ofs;
 				ofs += read_buf_avail;
@@ -1441,7 +1634,7 @@ struct Zip_DeflateUnpacker : ZIP_Unpacker
 			Bit8u *pWrite_buf_cur = write_buf + (out_buf_ofs & (WRITE_BLOCK-1));
 			Bit32u in_buf_size = read_buf_avail;
 
-			status = miniz::tinfl_decompress(&inflator, read_buf + read_buf_ofs, &in_buf_size, write_buf, pWrite_buf_cur, &out_buf_size, (comp_remaining ? miniz::TINFL_FLAG_HAS_MORE_INPUT : 0));
+			status = miniz::tinfl_decompress(&inflator, read_src + read_buf_ofs, &in_buf_size, write_buf, pWrite_buf_cur, &out_buf_size, (comp_remaining ? miniz::TINFL_FLAG_HAS_MORE_INPUT : 0));
 
 			if (crc_ofs == out_buf_ofs && out_buf_size)
 			{
@@ -1459,42 +1652,21 @@ struct Zip_DeflateUnpacker : ZIP_Unpacker
 			read_buf_ofs += in_buf_size;
 			out_buf_ofs += out_buf_size;
 			if (out_buf_ofs > f.decomp_size) { DBP_ASSERT(0); break; }
+			if (out_buf_size && (!(out_buf_ofs & (WRITE_BLOCK-1)) || out_buf_ofs == f.decomp_size))
+				cache.Put(f, (out_buf_ofs - 1) / WRITE_BLOCK, write_buf, ((out_buf_ofs - 1) & (WRITE_BLOCK-1)) + 1);
 
 			if (inflator.m_state == miniz::TINFL_STATE_INDEX_BLOCK_BOUNDRY)
 			{
-				// Gear cursors toward the middle of the block to accommodate forward and backward seeking as well as possible
 				Bit32u idx = (out_buf_ofs / cursor_block);
-				if (!cursors[idx].cursor_out || (out_buf_ofs > cursors[idx].cursor_out + 120*1024 && out_buf_ofs < idx*cursor_block + cursor_block/2 + 70*1024))
+				if (out_buf_ofs != f.decomp_size && WantCursor(cursors[idx], idx, out_buf_ofs, cursor_block))
 				{
 					//printf("[%s] STORE SEEK CURSOR #%u AT %u\n", f.name, idx, out_buf_ofs);
-					cursors[idx].cursor_in = ofs_last_read + read_buf_ofs;
-					cursors[idx].cursor_out = out_buf_ofs;
-					cursors[idx].m_num_bits                = inflator.m_num_bits;
-					cursors[idx].m_bit_buf                 = inflator.m_bit_buf;
-					cursors[idx].m_dist                    = inflator.m_dist;
-					cursors[idx].m_counter                 = inflator.m_counter;
-					cursors[idx].m_num_extra               = inflator.m_num_extra;
-					cursors[idx].m_dist_from_out_buf_start = inflator.m_dist_from_out_buf_start;
-					memcpy(cursors[idx].write_buf, write_buf, sizeof(write_buf));
+					StoreCursor(cursors[idx], inflator, ofs_last_read + read_buf_ofs, out_buf_ofs, write_buf);
 
 					// Write a seek cache next to the compressed file for larger files
 					if (seek_cache && idx > SEEK_CACHE_CURSOR_NEED)
 					{
-						Bit32u cursor_count = (Bit16u)((f.decomp_size + (cursor_block - 1)) / cursor_block), cursor_got = 0;
-						for (Bit32u ii = (SEEK_CACHE_CURSOR_STEPS / 2); ii < cursor_count; ii++)
-						{
-							if (!cursors[ii].cursor_out) continue;
-							cursor_got++;
-							ii = (SEEK_CACHE_CURSOR_STEPS / 2 - 1) + ((ii + (SEEK_CACHE_CURSOR_STEPS-1)) / SEEK_CACHE_CURSOR_STEPS * SEEK_CACHE_CURSOR_STEPS);
-						}
-						//printf("[%s] CURSORS FOR SEEK CACHE: %d / %d\n", f.name, cursor_got, (cursor_count+(SEEK_CACHE_CURSOR_STEPS-1))/SEEK_CACHE_CURSOR_STEPS);
-						if (cursor_got > cursor_count / (SEEK_CACHE_CURSOR_STEPS*2) && cursor_got > seek_cache->count && cursor_count <= 0xFFFF)
-						{
-							seek_cache->count = cursor_got;
-							const_cast<Zip_File&>(f).have_pic = 1;
-							PIC_RemoveSpecificEvents(Zip_File::PICHandler, (Bitu)&f);
-							PIC_AddEvent(Zip_File::PICHandler, 5.0f, (Bitu)&f);
-						}
+						UpdateSeekCache(f);
 
 						if (last_idx != idx)
 						{
@@ -1526,6 +1698,31 @@ struct Zip_DeflateUnpacker : ZIP_Unpacker
 		return true;
 	}
 
+	void UpdateSeekCache(const Zip_File& f, bool write_now = false)
+	{
+		Bit32u cursor_count = (Bit16u)((f.decomp_size + (cursor_block - 1)) / cursor_block), cursor_got = 0;
+		for (Bit32u ii = (SEEK_CACHE_CURSOR_STEPS / 2); ii < cursor_count; ii++)
+		{
+			if (!cursors[ii].cursor_out) continue;
+			cursor_got++;
+			ii = (SEEK_CACHE_CURSOR_STEPS / 2 - 1) + ((ii + (SEEK_CACHE_CURSOR_STEPS-1)) / SEEK_CACHE_CURSOR_STEPS * SEEK_CACHE_CURSOR_STEPS);
+		}
+		//printf("[%s] CURSORS FOR SEEK CACHE: %d / %d\n", f.name, cursor_got, (cursor_count+(SEEK_CACHE_CURSOR_STEPS-1))/SEEK_CACHE_CURSOR_STEPS);
+		if (cursor_got > cursor_count / (SEEK_CACHE_CURSOR_STEPS*2) && cursor_got > seek_cache->count && cursor_count <= 0xFFFF)
+		{
+			seek_cache->count = cursor_got;
+			if (write_now)
+			{
+				if (f.have_pic) { PIC_RemoveSpecificEvents(Zip_File::PICHandler, (Bitu)&f); const_cast<Zip_File&>(f).have_pic = 0; }
+				WriteSeekCache(f);
+				return;
+			}
+			const_cast<Zip_File&>(f).have_pic = 1;
+			PIC_RemoveSpecificEvents(Zip_File::PICHandler, (Bitu)&f);
+			PIC_AddEvent(Zip_File::PICHandler, 5.0f, (Bitu)&f);
+		}
+	}
+
 	void WriteSeekCache(const Zip_File& f)
 	{
 		DOS_File *df;
@@ -1560,12 +1757,234 @@ void Zip_File::PICHandler(Bitu implPtr)
 	f.have_pic = 0;
 }
 
+struct Zip_IndexJob
+{
+	Zip_File* f;
+	Zip_DeflateUnpacker::SeekCursor* cursors;
+	Bit32u cursor_block, cursor_count;
+	Bit32u done_idx, synced_idx; // cursors before done_idx are final (guarded by indexer lock)
+	volatile Bit32u progress;
+	volatile bool abort, finished;
+	bool queued, started; // guarded by indexer lock
+};
+
+void Zip_DeflateUnpacker::RunIndexJob(Zip_Archive& archive, Mutex& lock, Zip_IndexJob& job)
+{
+	// Same inflate loop as Read but without any output, only filling the seek cursors of the job
+	const Zip_File& f = *job.f;
+	miniz::tinfl_decompressor inflator;
+	miniz::tinfl_init(&inflator);
+	Bit8u read_buf[READ_BLOCK], write_buf[WRITE_BLOCK];
+	const Bit8u* read_src = NULL;
+	Bit64u ofs = f.data_ofs, ofs_last_read = ofs;
+	Bit32u comp_remaining = f.comp_size, out_buf_ofs = 0, read_buf_avail = 0, read_buf_ofs = 0, last_idx = 0;
+	miniz::tinfl_status status = miniz::TINFL_STATUS_NEEDS_MORE_INPUT;
+	while ((status == miniz::TINFL_STATUS_NEEDS_MORE_INPUT || status == miniz::TINFL_STATUS_HAS_MORE_OUTPUT) && !job.abort)
+	{
+		if (!read_buf_avail)
+		{
+			read_buf_avail = (comp_remaining < READ_BLOCK ? comp_remaining : READ_BLOCK);
+			if (!read_buf_avail || !(read_src = archive.Fetch(ofs, read_buf, read_buf_avail)))
+				break;
+			ofs_last_read = ofs;
+			ofs += read_buf_avail;
+			comp_remaining -= read_buf_avail;
+			read_buf_ofs = 0;
+			job.progress = out_buf_ofs;
+		}
+
+		Bit32u out_buf_size = WRITE_BLOCK - (out_buf_ofs & (WRITE_BLOCK-1));
+		Bit32u in_buf_size = read_buf_avail;
+		status = miniz::tinfl_decompress(&inflator, read_src + read_buf_ofs, &in_buf_size, write_buf, write_buf + (out_buf_ofs & (WRITE_BLOCK-1)), &out_buf_size, (comp_remaining ? miniz::TINFL_FLAG_HAS_MORE_INPUT : 0));
+		read_buf_avail -= in_buf_size;
+		read_buf_ofs += in_buf_size;
+		out_buf_ofs += out_buf_size;
+		if (out_buf_ofs >= f.decomp_size) break;
+
+		if (inflator.m_state == miniz::TINFL_STATE_INDEX_BLOCK_BOUNDRY)
+		{
+			Bit32u idx = (out_buf_ofs / job.cursor_block);
+			if (idx != last_idx) { lock.Lock(); job.done_idx = last_idx = idx; lock.Unlock(); }
+			if (WantCursor(job.cursors[idx], idx, out_buf_ofs, job.cursor_block))
+				StoreCursor(job.cursors[idx], inflator, ofs_last_read + read_buf_ofs, out_buf_ofs, write_buf);
+		}
+	}
+	lock.Lock();
+	if (out_buf_ofs == f.decomp_size) job.done_idx = job.cursor_count;
+	job.progress = f.decomp_size;
+	job.finished = true;
+	lock.Unlock();
+}
+
+void Zip_DeflateUnpacker::AbortIndexJob(const Zip_File& f)
+{
+	f.index_job->abort = true;
+}
+
+void Zip_DeflateUnpacker::SyncIndex(const Zip_File& f)
+{
+	Zip_IndexJob& job = *f.index_job;
+	archive.lock->Lock();
+	Bit32u done_idx = job.done_idx;
+	bool finished = job.finished;
+	archive.lock->Unlock();
+
+	if (done_idx > job.synced_idx)
+	{
+		DBP_ASSERT(job.cursor_block == cursor_block);
+		for (Bit32u idx = job.synced_idx; idx != done_idx; idx++)
+			if (job.cursors[idx].cursor_out && !cursors[idx].cursor_out)
+				memcpy(&cursors[idx], &job.cursors[idx], sizeof(SeekCursor));
+		job.synced_idx = done_idx;
+	}
+	if (finished)
+	{
+		// Progress of the index threads depends on the host so don't schedule an emulated event for writing the seek cache
+		if (seek_cache) UpdateSeekCache(f, true);
+		free(job.cursors);
+		job.cursors = NULL;
+		const_cast<Zip_File&>(f).index_job = NULL;
+	}
+}
+
+struct Zip_Indexer
+{
+	Zip_Archive& archive;
+	Mutex lock;
+	std::vector<Zip_IndexJob> jobs;
+	Semaphore threads_done;
+	Bit32u threads_running; // guarded by lock
+	bool stopping; // guarded by lock
+	static std::vector<Zip_Indexer*> active;
+	static int shown_percent;
+
+	Zip_Indexer(Zip_Archive& _archive) : archive(_archive), threads_running(0), stopping(false) { }
+
+	~Zip_Indexer()
+	{
+		lock.Lock();
+		for (Zip_IndexJob& job : jobs) job.abort = true;
+		stopping = true;
+		bool wait = (threads_running != 0);
+		lock.Unlock();
+		if (wait) threads_done.Wait(); // workers will finish the current inflate step and exit
+		archive.lock = NULL;
+		for (Zip_IndexJob& job : jobs)
+		{
+			if (job.f->index_job == &job) job.f->index_job = NULL;
+			free(job.cursors);
+		}
+		for (size_t i = 0; i != active.size(); i++)
+			if (active[i] == this) { active.erase(active.begin() + i); break; }
+	}
+
+	void AddJob(Zip_File& f)
+	{
+		Zip_IndexJob job;
+		job.f = &f;
+		job.cursor_block = Zip_DeflateUnpacker::GetCursorBlock(f.decomp_size);
+		job.cursor_count = (f.decomp_size + (job.cursor_block - 1)) / job.cursor_block;
+		job.cursors = NULL;
+		job.done_idx = job.synced_idx = job.progress = 0;
+		job.abort = job.finished = job.queued = job.started = false;
+		jobs.push_back(job);
+	}
+
+	void Start()
+	{
+		// Jobs only get queued once their file is opened, indexing files which aren't loaded is wasted work on every mount
+		active.push_back(this);
+	}
+
+	void Queue(Zip_File& f)
+	{
+		if (f.index_job) return;
+		Zip_IndexJob* job = NULL;
+		for (Zip_IndexJob& it : jobs) if (it.f == &f) { job = &it; break; }
+		if (!job || job->queued) return;
+		archive.lock = &lock;
+		f.index_job = job;
+
+		// Use up to half of the available cores, the emulation thread and the frontend need the rest
+		extern unsigned dbp_cpu_features_get_core_amount(void);
+		Bit32u cores = (Bit32u)dbp_cpu_features_get_core_amount() / 2;
+		Bit32u num = (cores < 1 ? 1 : cores > 4 ? 4 : cores);
+		lock.Lock();
+		job->queued = true;
+		bool start = (threads_running < num);
+		if (start) threads_running++;
+		lock.Unlock();
+		if (start) Thread::StartDetached(IndexThread, this);
+	}
+
+	static Thread::RET_t THREAD_CC IndexThread(void* p)
+	{
+		Zip_Indexer& ix = *(Zip_Indexer*)p;
+		for (;;)
+		{
+			ix.lock.Lock();
+			Zip_IndexJob* next = NULL;
+			if (!ix.stopping)
+				for (Zip_IndexJob& it : ix.jobs)
+					if (it.queued && !it.started) { next = &it; break; }
+			if (!next)
+			{
+				// When stopping, the last thread to exit signals the destructor, ix can be gone right after so it can't be accessed anymore
+				bool last = (--ix.threads_running == 0 && ix.stopping);
+				ix.lock.Unlock();
+				if (last) ix.threads_done.Post();
+				return 0;
+			}
+			Zip_IndexJob& job = *next;
+			job.started = true;
+			job.cursors = (Zip_DeflateUnpacker::SeekCursor*)calloc(job.cursor_count, sizeof(Zip_DeflateUnpacker::SeekCursor));
+			ix.lock.Unlock();
+			Zip_DeflateUnpacker::RunIndexJob(ix.archive, ix.lock, job);
+		}
+	}
+
+	static void Poll()
+	{
+		// Called by the emulation thread at the end of every frame instead of from an emulated event because progress depends on the speed of the host
+		Bit64u total = 0, done = 0;
+		bool running = false;
+		for (Zip_Indexer* ix : active)
+		{
+			for (Zip_IndexJob& job : ix->jobs)
+			{
+				if (!job.queued) continue;
+				// Move finished cursors into already opened files so the seek cache gets written even when the guest stops reading
+				Zip_File& f = *job.f;
+				if (f.index_job == &job && f.unpacker) ((Zip_DeflateUnpacker*)f.unpacker)->SyncIndex(f);
+				total += f.decomp_size;
+				done += job.progress;
+				if (job.finished && job.cursors && (job.abort || f.index_job != &job))
+				{
+					// Cursors of a job that got aborted or detached from its file won't be used anymore
+					free(job.cursors);
+					job.cursors = NULL;
+				}
+				if (!job.finished) running = true;
+			}
+		}
+		int percent = (running ? (int)(done * 100 / total) : -1);
+		if (percent == shown_percent) return;
+		shown_percent = percent;
+		if (percent < 0) return;
+		extern void emuthread_notify(int duration, LOG_SEVERITIES lvl, char const* format,...);
+		emuthread_notify(-1100, LOG_NORMAL, "Indexando arquivos compactados: %d%%", percent);
+	}
+};
+
+std::vector<Zip_Indexer*> Zip_Indexer::active;
+int Zip_Indexer::shown_percent = -1;
+
 struct Zip_Handle : public DOS_File
 {
 	Bit32u ofs;
 	Zip_File* src;
 
-	Zip_Handle(Zip_Archive& archive, Zip_File* _src, Bit32u _flags, zipDrive* drv, const char* path) : ofs(0), src(_src)
+	Zip_Handle(Zip_Archive& archive, Zip_BlockCache& cache, Zip_File* _src, Bit32u _flags, zipDrive* drv, const char* path) : ofs(0), src(_src)
 	{
 		_src->refs++;
 		date = _src->date;
@@ -1578,7 +1997,7 @@ struct Zip_Handle : public DOS_File
 			else if (_src->method == ZIP_Unpacker::METHOD_DEFLATED)
 			{
 				enum { MINIMAL_SIZE = (sizeof(Zip_DeflateUnpacker) + sizeof(Zip_DeflateUnpacker::SeekCursor)) };
-				if (_src->decomp_size > MINIMAL_SIZE) _src->unpacker = new Zip_DeflateUnpacker(archive, *_src, drv, path);
+				if (_src->decomp_size > MINIMAL_SIZE) _src->unpacker = new Zip_DeflateUnpacker(archive, cache, *_src, drv, path);
 				else                                  _src->unpacker = new Zip_DeflateMemoryUnpacker(archive, *_src);
 			}
 			else if (_src->method == ZIP_Unpacker::METHOD_STORED)   _src->unpacker = new Zip_StoredUnpacker(archive);
@@ -1703,6 +2122,8 @@ struct zipDriveImpl
 	std::vector<Zip_Search> searches;
 	std::vector<Bit16u> free_search_ids;
 	Bit64u total_decomp_size;
+	Zip_Indexer* indexer;
+	Zip_BlockCache block_cache;
 
 	// Various ZIP archive enums. To completely avoid cross platform compiler alignment and platform endian issues, miniz.c doesn't use structs for any of this stuff.
 	enum
@@ -1728,7 +2149,7 @@ struct zipDriveImpl
 		MZ_ZIP_LDH_FILENAME_LEN_OFS = 26, MZ_ZIP_LDH_EXTRA_LEN_OFS = 28,
 	};
 
-	zipDriveImpl(DOS_File* _zip, bool enable_crc_check, bool enter_solo_root_dir, std::string** out_parent = NULL, bool* out_multi_parent = NULL, zipDriveImpl* child_impl = NULL) : archive(_zip, enable_crc_check), root(DOS_ATTR_VOLUME|DOS_ATTR_DIRECTORY, "", 0xFFFF, 0xFFFF, 0), total_decomp_size(0)
+	zipDriveImpl(DOS_File* _zip, bool enable_crc_check, bool enter_solo_root_dir, std::string** out_parent = NULL, bool* out_multi_parent = NULL, zipDriveImpl* child_impl = NULL) : archive(_zip, enable_crc_check), root(DOS_ATTR_VOLUME|DOS_ATTR_DIRECTORY, "", 0xFFFF, 0xFFFF, 0), total_decomp_size(0), indexer(NULL)
 	{
 		// Basic sanity checks - reject files which are too small.
 		if (archive.size < MZ_ZIP_END_OF_CENTRAL_DIR_HEADER_SIZE)
@@ -1925,6 +2346,34 @@ struct zipDriveImpl
 		if (root.time == 0xFFFF) root.time = root.date = 0;
 	}
 
+	~zipDriveImpl()
+	{
+		delete indexer;
+	}
+
+	void StartIndexer()
+	{
+		// Prepare jobs to precompute seek cursors of large deflated files on background threads once they get opened so random access doesn't need to inflate everything before it
+		struct Local
+		{
+			static void AddJobs(zipDriveImpl& impl, Zip_Directory& dir)
+			{
+				for (Zip_Entry* e : dir.entries)
+				{
+					if (e->IsDirectory()) { AddJobs(impl, *e->AsDirectory()); continue; }
+					Zip_File& f = *e->AsFile();
+					Bit32u cursor_block = Zip_DeflateUnpacker::GetCursorBlock(f.decomp_size);
+					if (f.method != ZIP_Unpacker::METHOD_DEFLATED || (f.decomp_size + (cursor_block - 1)) / cursor_block <= Zip_DeflateUnpacker::SEEK_CACHE_CURSOR_NEED) continue;
+					if (!f.ofs_past_header && !impl.SetOfsPastHeader(f)) continue;
+					if (!impl.indexer) impl.indexer = new Zip_Indexer(impl.archive);
+					impl.indexer->AddJob(f);
+				}
+			}
+		};
+		Local::AddJobs(*this, root);
+		if (indexer) indexer->Start();
+	}
+
 	bool SetOfsPastHeader(Zip_File& f)
 	{
 		char local_header[MZ_ZIP_LOCAL_DIR_HEADER_SIZE];
@@ -1990,6 +2439,7 @@ DOS_Drive* zipDrive::MountWithDependencies(const char* path, std::string*& error
 
 			zipDrive* zip_drive = new zipDrive();
 			zip_drive->impl = impl;
+			impl->StartIndexer();
 			zip_drive->label.SetLabel("ZIP", false, true);
 
 			size_t len = strlen(path);
@@ -2041,7 +2491,8 @@ bool zipDrive::FileOpen(DOS_File * * file, char * name, Bit32u flags)
 	if (!e->AsFile()->ofs_past_header && !impl->SetOfsPastHeader(*e->AsFile()))
 		return FALSE_SET_DOSERR(DATA_INVALID); //ZIP error
 
-	*file = new Zip_Handle(impl->archive, e->AsFile(), flags, this, name);
+	if (impl->indexer) impl->indexer->Queue(*e->AsFile()); // before the handle so a seek cache file can abort the job
+	*file = new Zip_Handle(impl->archive, impl->block_cache, e->AsFile(), flags, this, name);
 	return true;
 }
 
@@ -2202,7 +2653,7 @@ bool zipDrive::isRemote(void) { return false; }
 bool zipDrive::isRemovable(void) { return false; }
 Bits zipDrive::UnMount(void) { delete this; return 0;  }
 
-void zipDrive::Uncompress(const Bit8u* src, Bit32u src_len, Bit8u* trg, Bit32u trg_len)
+bool zipDrive::Uncompress(const Bit8u* src, Bit32u src_len, Bit8u* trg, Bit32u trg_len)
 {
 	miniz::tinfl_decompressor inflator;
 	miniz::tinfl_init(&inflator);
@@ -2215,6 +2666,42 @@ void zipDrive::Uncompress(const Bit8u* src, Bit32u src_len, Bit8u* trg, Bit32u t
 		trg += out_size;
 		DBP_ASSERT(status == miniz::TINFL_STATUS_HAS_MORE_OUTPUT || status == miniz::TINFL_STATUS_DONE);
 	}
+	return (trg == trg_end);
+}
+
+Bit32u zipDrive::Compress(const Bit8u* src, Bit32u src_len, Bit8u* trg, sdefl*& workmem, int level)
+{
+	if (!workmem) workmem = new sdefl;
+	return workmem->Run(trg, src, (int)src_len, level);
+}
+
+void zipDrive::FreeCompressMemory(sdefl*& workmem)
+{
+	delete workmem;
+	workmem = NULL;
+}
+
+void zipDrive::SetCacheBudget(Bit32u bytes)
+{
+	Zip_BlockCache::budget = bytes;
+}
+
+void zipDrive::GetCacheStats(Bit32u& used, Bit32u& hits, Bit32u& misses)
+{
+	used = hits = misses = 0;
+	Zip_BlockCache::all_lock.Lock();
+	for (const Zip_BlockCache* cache : Zip_BlockCache::all)
+	{
+		used += cache->used;
+		hits += cache->hits;
+		misses += cache->misses;
+	}
+	Zip_BlockCache::all_lock.Unlock();
+}
+
+void zipDrive::PollIndexers()
+{
+	if (!Zip_Indexer::active.empty()) Zip_Indexer::Poll();
 }
 
 #include <dbp_serialize.h>
@@ -775,7 +775,16 @@ public:
 	virtual bool isRemote(void);
 	virtual bool isRemovable(void);
 	virtual Bits UnMount(void);
-	static void Uncompress(const Bit8u* src, Bit32u src_len, Bit8u* trg, Bit32u trg_len);
+	static bool Uncompress(const Bit8u* src, Bit32u src_len, Bit8u* trg, Bit32u trg_len);
+	// trg needs space for (src_len + src_len / 8 + 16) bytes and src must be readable for 4 bytes past src_len
+	// workmem gets allocated on first use and needs to be released with FreeCompressMemory
+	static Bit32u Compress(const Bit8u* src, Bit32u src_len, Bit8u* trg, struct sdefl*& workmem, int level = 9);
+	static void FreeCompressMemory(struct sdefl*& workmem);
+	// memory budget for decompressed blocks of deflated files, per mounted zip drive
+	static void SetCacheBudget(Bit32u bytes);
+	static void GetCacheStats(Bit32u& used, Bit32u& hits, Bit32u& misses);
+	// sync background indexing into opened files and show its progress, called by the emulation thread once per frame
+	static void PollIndexers();
 private:
 	struct zipDriveImpl* impl;
 	INLINE zipDrive() {}
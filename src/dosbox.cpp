@@ -44,6 +44,7 @@
 #include "ints/int10.h"
 #include "render.h"
 #include "pci_bus.h"
+#include "dbp_profiler.h"
 
 Config * control;
 MachineType machine;
@@ -213,7 +214,9 @@ static Bitu Normal_Loop(void) {
 			if (ret>0) {
 				if (GCC_UNLIKELY(ret >= CB_MAX)) return 0;
 				paging_prevent_exception_jump = true;
+				DBP_PROFILE_BEGIN();
 				Bitu blah = (*CallBack_Handlers[ret])();
+				DBP_PROFILE_END(KIND_CALLBACK, ret);
 				paging_prevent_exception_jump = false;
 				if (GCC_UNLIKELY(blah)) return blah;
 			}
@@ -718,6 +721,9 @@ void DOSBOX_Init(void) {
 
 #ifdef C_DBP_LIBRETRO
 	secprop->Add_bool("swapstereo",Property::Changeable::WhenIdle,false);
+	const char* resamplers[] = { "linear", "polyphase", 0 };
+	Pstring = secprop->Add_string("resampler",Property::Changeable::WhenIdle,"linear");
+	Pstring->Set_values(resamplers);
 #endif
 
 	secprop=control->AddSection_prop("midi",&MIDI_Init,true);//done
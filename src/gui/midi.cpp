@@ -35,6 +35,7 @@
 #include "pic.h"
 #include "hardware.h"
 #include "timer.h"
+#include "dbp_threads.h"
 
 #define RAWBUF	1024
 
@@ -70,6 +71,11 @@ MidiHandler::MidiHandler(){
 
 MidiHandler Midi_none;
 
+//DBP: Latency in milliseconds of software synthesizers rendering on their own thread (0 to render synchronously)
+//     and the maximum number of voices of the SoundFont synthesizer (0 for unlimited) and if it splits voices across worker threads
+Bit32u dbp_midi_thread_ms, dbp_midi_polyphony;
+bool dbp_midi_tsf_threads;
+
 #ifdef DBP_STANDALONE
 #define C_DBP_NATIVE_MIDI
 #define C_SUPPORTS_COREMIDI
@@ -20,39 +20,146 @@
 #include "support.h"
 #include "cross.h"
 #include "../dos/drives.h"
+#include <sys/stat.h>
+#if defined(WIN32)
+#include <io.h>
+#elif (C_HAVE_MPROTECT)
+#include <sys/mman.h>
+#endif
 #ifdef _MSC_VER
 #pragma warning ( disable : 4244 ) // conversion from 'double' to 'float', possible loss of data
 #endif
 #include "mt32emu.h"
 
 static void MIDI_MT32_CallBack(Bitu len);
+extern Bit32u dbp_midi_thread_ms;
 
 struct MidiHandler_mt32 : public MidiHandler
 {
-	MidiHandler_mt32() : MidiHandler(), chan(NULL), mo(NULL), f_control(NULL), f_pcm(NULL), d_zip(NULL), syn(NULL) {}
+	MidiHandler_mt32() : MidiHandler(), chan(NULL), mo(NULL), f_control(NULL), f_pcm(NULL), d_zip(NULL), syn(NULL), ring(NULL), thread_ms(0), thread_active(false) {}
 	MixerChannel*   chan;
 	MixerObject*    mo;
 	DOS_File*       f_control;
 	DOS_File*       f_pcm;
 	DOS_Drive*      d_zip;
+	std::string     key_control, key_pcm; // identifies ROM files in the SHA1 index, empty for ROMs loaded from the mounted content
 	MT32Emu::Synth* syn;
 
+	// When rendering on a separate thread, the synth renders ahead into a ring buffer up to a fixed latency past the consumed output.
+	// MIDI events get timestamped at that latency so they are always still in the future for the render thread which keeps output deterministic.
+	enum { RING_SIZE = 16384, RING_MASK = RING_SIZE - 1, MAX_MIX_LEN = MIXER_BUFSIZE/4, RENDER_CHUNK = 512 };
+	Bit16s*         ring;
+	Bit32u          ring_rendered, ring_consumed, ring_target, ring_ahead, out_rate, event_base, thread_ms;
+	bool            thread_active, thread_run;
+	Mutex           ring_mutex;
+	Semaphore       sem_work, sem_done;
+
 	const char * GetName(void) { return "mt32"; };
 
 	struct RomFile : public MT32Emu::File
 	{
-		RomFile(DOS_File*& f) : data(NULL), size(0)
+		RomFile(DOS_File*& f, const std::string& key) : data(NULL), size(0), mapped(false)
 		{
 			if (!f) return;
-			Bit32u begin = 0;
+			Bit32u begin = 0, stamp = ((Bit32u)f->date << 16) | f->time;
 			f->Seek(&size, SEEK_END);
 			f->Seek(&begin, SEEK_SET);
-			data = new Bit8u[size];
-			for (Bit32u sz = size, p = 0; sz;) { Bit16u read = (Bit16u)(sz > 0xFFFF ? 0xFFFF : sz); if (!f->Read(data+p, &read)) break; sz -= read; p += read; }
+			if (rawFile* raw = dynamic_cast<rawFile*>(f))
+			{
+				// ROM files on the host file system get mapped into memory instead of being read into a copy
+				#if defined(WIN32)
+				struct _stat st;
+				if (!_fstat(_fileno(raw->f), &st)) stamp = (Bit32u)st.st_mtime;
+				HANDLE mapping = (size ? CreateFileMappingA((HANDLE)_get_osfhandle(_fileno(raw->f)), NULL, PAGE_READONLY, 0, 0, NULL) : NULL);
+				if (mapping) { data = (Bit8u*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0); CloseHandle(mapping); }
+				#else
+				struct stat st;
+				if (!fstat(fileno(raw->f), &st)) stamp = (Bit32u)st.st_mtime;
+				#if (C_HAVE_MPROTECT)
+				void* p = (size ? mmap(NULL, (size_t)size, PROT_READ, MAP_SHARED, fileno(raw->f), 0) : MAP_FAILED);
+				if (p != MAP_FAILED) data = (Bit8u*)p;
+				#endif
+				#endif
+				mapped = (data != NULL);
+			}
+			if (!data)
+			{
+				data = new Bit8u[size];
+				for (Bit32u sz = size, p = 0; sz;) { Bit16u read = (Bit16u)(sz > 0xFFFF ? 0xFFFF : sz); if (!f->Read(data+p, &read)) break; sz -= read; p += read; }
+			}
 			f->Close();
 			delete f;
 			f = NULL;
 
+			// Identifying the ROM needs its SHA1 which gets remembered in an index in the system directory keyed by path, size and modification time
+			if (key.empty() || !IndexLookup(key, stamp))
+			{
+				CalculateSHA1();
+				if (!key.empty()) IndexStore(key, stamp);
+			}
+		}
+
+		~RomFile()
+		{
+			if (!data) return;
+			#if defined(WIN32)
+			if (mapped) { UnmapViewOfFile(data); return; }
+			#elif (C_HAVE_MPROTECT)
+			if (mapped) { munmap(data, (size_t)size); return; }
+			#endif
+			delete[] data;
+		}
+
+		bool IndexLookup(const std::string& key, Bit32u stamp)
+		{
+			FILE* DBP_FileOpenSystem(const char* fname, const char* mode);
+			FILE* fi = DBP_FileOpenSystem("DOSBoxPureRomIndex.txt", "r");
+			if (!fi) return false;
+			char line[1024]; bool found = false;
+			while (!found && fgets(line, sizeof(line), fi))
+			{
+				unsigned int lsize, lstamp; int keypos = 0; size_t len = strlen(line);
+				while (len && (line[len-1] == '\n' || line[len-1] == '\r')) line[--len] = '\0';
+				if (sscanf(line, "%40s %u %u %n", sha1Digest, &lsize, &lstamp, &keypos) < 3 || !keypos || strlen(sha1Digest) != 40) continue;
+				found = (lsize == size && lstamp == stamp && key == (line + keypos));
+			}
+			fclose(fi);
+			return found;
+		}
+
+		void IndexStore(const std::string& key, Bit32u stamp)
+		{
+			// Rewrite the index with the new entry at the end, keeping only the latest entry of each path and dropping the oldest beyond the limit
+			enum { MAX_ENTRIES = 64 };
+			FILE* DBP_FileOpenSystem(const char* fname, const char* mode);
+			std::vector<std::string> lines;
+			std::vector<size_t> keyposs;
+			if (FILE* fi = DBP_FileOpenSystem("DOSBoxPureRomIndex.txt", "r"))
+			{
+				char line[1024], digest[41];
+				while (fgets(line, sizeof(line), fi))
+				{
+					unsigned int lsize, lstamp; int keypos = 0; size_t len = strlen(line);
+					while (len && (line[len-1] == '\n' || line[len-1] == '\r')) line[--len] = '\0';
+					if (sscanf(line, "%40s %u %u %n", digest, &lsize, &lstamp, &keypos) < 3 || !keypos || strlen(digest) != 40 || key == (line + keypos)) continue;
+					for (size_t i = 0; i != lines.size(); i++)
+						if (!strcmp(lines[i].c_str() + keyposs[i], line + keypos)) { lines.erase(lines.begin() + i); keyposs.erase(keyposs.begin() + i); break; }
+					lines.push_back(line);
+					keyposs.push_back((size_t)keypos);
+				}
+				fclose(fi);
+			}
+			if (lines.size() >= MAX_ENTRIES) lines.erase(lines.begin(), lines.end() - (MAX_ENTRIES - 1));
+			if (FILE* fi = DBP_FileOpenSystem("DOSBoxPureRomIndex.txt", "w"))
+			{
+				for (const std::string& line : lines) fprintf(fi, "%s\n", line.c_str());
+				fprintf(fi, "%s %u %u %s\n", sha1Digest, (unsigned int)size, (unsigned int)stamp, key.c_str());
+				fclose(fi);
+			}
+		}
+
+		void CalculateSHA1()
+		{
 			SHA1_CTX ctx;
 			SHA1_CTX::SHA1Process(&ctx, (const unsigned char*)data, size);
 			unsigned char finalcount[8];
@@ -70,7 +177,6 @@ struct MidiHandler_mt32 : public MidiHandler
 			sha1Digest[40] = '\0';
 		}
 
-		~RomFile() { if (data) delete[] data; }
 		void close() {}
 		size_t getSize() { return size; }
 		const Bit8u *getData() { return data; }
@@ -79,6 +185,7 @@ struct MidiHandler_mt32 : public MidiHandler
 		char sha1Digest[41];
 		Bit8u *data;
 		Bit32u size;
+		bool mapped;
 
 		struct SHA1_CTX
 		{
@@ -162,7 +269,10 @@ struct MidiHandler_mt32 : public MidiHandler
 		MidiHandler_mt32& self = *(MidiHandler_mt32*)data;
 		if (DOS_File** pf = (((size == 65536 || size == 131072) && !self.f_control) ? &self.f_control : (((size == 524288 || size == 1048576) && !self.f_pcm) ? &self.f_pcm : NULL)))
 			if (self.d_zip->FileOpen(pf, (char*)path, OPEN_READ))
+			{
 				(*pf)->AddRef();
+				(pf == &self.f_control ? self.key_control : self.key_pcm).append(":").append(path);
+			}
 	}
 
 	bool Open(const char * conf)
@@ -175,6 +285,8 @@ struct MidiHandler_mt32 : public MidiHandler
 			FILE* zip_file_h = DBP_FileOpenContentOrSystem(conf + 2);
 			if (!zip_file_h) return false;
 			d_zip = new zipDrive(new rawFile(zip_file_h, false));
+			key_control.assign(conf);
+			key_pcm.assign(conf);
 			DriveFileIterator(d_zip, IterateZip, (Bitu)this);
 		}
 		else
@@ -197,6 +309,7 @@ struct MidiHandler_mt32 : public MidiHandler
 
 			DBP_ASSERT(!f_pcm);
 			f_pcm = FindAndOpenDosFile(pcmpath);
+			if (*conf != '$') { key_control.assign(conf); key_pcm.assign(pcmpath); }
 		}
 		if (!f_control || !f_pcm) { Close(); return false; }
 
@@ -211,6 +324,10 @@ struct MidiHandler_mt32 : public MidiHandler
 		if (f_control) { f_control->Close(); delete f_control; f_control = NULL; }
 		if (f_pcm)     { f_pcm->Close(); delete f_pcm;         f_pcm     = NULL; }
 		if (d_zip)     { delete d_zip;                         d_zip     = NULL; }
+		key_control.clear();
+		key_pcm.clear();
+		StopThread();
+		if (ring)      { delete[] ring;                        ring      = NULL; }
 		if (syn)       { syn->close(); delete syn;             syn       = NULL; }
 		if (chan)      { chan->Enable(false);                  chan      = NULL; }
 		if (mo)        { delete mo;                            mo        = NULL; } // also deletes chan!
@@ -221,8 +338,8 @@ struct MidiHandler_mt32 : public MidiHandler
 		if (syn) return true;
 		if (!f_control || !f_pcm) return false;
 
-		RomFile control_rom_file(f_control); // deletes and NULL's f_control
-		RomFile pcm_rom_file(f_pcm); // deletes and NULL's f_pcm
+		RomFile control_rom_file(f_control, key_control); // deletes and NULL's f_control
+		RomFile pcm_rom_file(f_pcm, key_pcm); // deletes and NULL's f_pcm
 		if (d_zip) { delete d_zip; d_zip = NULL; }
 
 		syn = new MT32Emu::Synth();
@@ -237,22 +354,123 @@ struct MidiHandler_mt32 : public MidiHandler
 			syn = NULL;
 			return false;
 		}
-		chan->SetFreq(syn->getStereoOutputSampleRate());
+		// Store SysEx data in a preallocated buffer so the render thread never deals with memory allocation
+		syn->setMIDIEventQueueSize(4096);
+		syn->configureMIDIEventQueueSysexStorage(32768);
+		out_rate = syn->getStereoOutputSampleRate();
+		chan->SetFreq(out_rate);
 		chan->Enable(true);
+		UpdateThread();
 		return true;
 	}
 
+	void UpdateThread()
+	{
+		if (thread_ms == dbp_midi_thread_ms) return;
+		StopThread();
+		if (!(thread_ms = dbp_midi_thread_ms)) return;
+		if (!ring) ring = new Bit16s[RING_SIZE * 2];
+		ring_ahead = (Bit32u)((Bit64u)out_rate * thread_ms / 1000);
+		if (ring_ahead > RING_SIZE - MAX_MIX_LEN) ring_ahead = RING_SIZE - MAX_MIX_LEN;
+		ring_rendered = ring_consumed = 0;
+		ring_target = ring_ahead;
+		event_base = syn->getInternalRenderedSampleCount();
+		thread_active = thread_run = true;
+		Thread::StartDetached(RenderThread, this);
+	}
+
+	void StopThread()
+	{
+		if (!thread_active) return;
+		ring_mutex.Lock();
+		thread_run = false;
+		ring_mutex.Unlock();
+		for (sem_work.Post(); thread_active;) sem_done.Wait();
+		thread_ms = 0;
+	}
+
+	static Thread::RET_t THREAD_CC RenderThread(void* p)
+	{
+		MidiHandler_mt32& self = *(MidiHandler_mt32*)p;
+		for (;;)
+		{
+			self.ring_mutex.Lock();
+			Bit32u from = self.ring_rendered, n = self.ring_target - from;
+			bool run = self.thread_run;
+			self.ring_mutex.Unlock();
+			if (!run) break;
+			if (!n || n > RING_SIZE) { self.sem_work.Wait(); continue; }
+
+			Bit32u ofs = (from & RING_MASK);
+			if (n > RING_SIZE - ofs) n = RING_SIZE - ofs;
+			if (n > RENDER_CHUNK) n = RENDER_CHUNK;
+			self.syn->render(self.ring + ofs * 2, n);
+
+			self.ring_mutex.Lock();
+			self.ring_rendered = from + n;
+			self.ring_mutex.Unlock();
+			self.sem_done.Post();
+		}
+		self.ring_mutex.Lock();
+		self.thread_active = false;
+		self.ring_mutex.Unlock();
+		self.sem_done.Post();
+		return 0;
+	}
+
+	void Mix(Bitu len)
+	{
+		if (!thread_active)
+		{
+			syn->render((Bit16s*)MixTemp, (Bit32u)len);
+			return;
+		}
+
+		// Make sure the render thread is at least len samples ahead, then take them out of the ring buffer
+		ring_mutex.Lock();
+		if (ring_target - ring_consumed < len) ring_target = ring_consumed + (Bit32u)len;
+		ring_mutex.Unlock();
+		sem_work.Post();
+		for (;;)
+		{
+			ring_mutex.Lock();
+			bool ready = (ring_rendered - ring_consumed >= len);
+			ring_mutex.Unlock();
+			if (ready) break;
+			sem_done.Wait();
+		}
+		Bit32u ofs = (ring_consumed & RING_MASK), first = RING_SIZE - ofs;
+		if (first > len) first = (Bit32u)len;
+		memcpy(MixTemp, ring + ofs * 2, first * 4);
+		memcpy(MixTemp + first * 4, ring, (len - first) * 4);
+
+		ring_mutex.Lock();
+		ring_consumed += (Bit32u)len;
+		ring_target = ring_consumed + ring_ahead;
+		ring_mutex.Unlock();
+		sem_work.Post();
+	}
+
+	Bit32u EventTimestamp()
+	{
+		// Timestamp in internal synth samples at the output position one latency past the emulated current time
+		Bit32u out_pos = ring_consumed + ring_ahead + (Bit32u)(PIC_TickIndex() * out_rate / 1000);
+		return event_base + (Bit32u)((Bit64u)out_pos * MT32Emu::SAMPLE_RATE / out_rate);
+	}
+
 	void PlayMsg(Bit8u * msg)
 	{
 		if (!syn && (!f_control || !LoadSynth())) return;
 		Bit32u msg32 = ((Bit32u)(msg[0]) | ((Bit32u)(msg[1]) << 8U) | ((Bit32u)(msg[2]) << 16U) | ((Bit32u)(msg[3]) << 24U));
-		syn->playMsg(msg32);
+		if (!thread_active) syn->playMsg(msg32);
+		else if (!syn->playMsg(msg32, EventTimestamp())) LOG_MSG("MT32: MIDI event queue overflow");
 	};
 
 	void PlaySysex(Bit8u * sysex,Bitu len)
 	{
 		if (!syn && (!f_control || !LoadSynth())) return;
-		syn->playSysex(sysex, (Bit32u)len);
+		if (!thread_active) syn->playSysex(sysex, (Bit32u)len);
+		else if (!syn->playSysex(sysex, (Bit32u)len, EventTimestamp())) LOG_MSG("MT32: MIDI event queue overflow");
 	}
 };
 
@@ -262,6 +480,7 @@ static void MIDI_MT32_CallBack(Bitu len)
 {
 	DBP_ASSERT(len <= (MIXER_BUFSIZE/4));
 	if (len > (MIXER_BUFSIZE/4)) len = (MIXER_BUFSIZE/4);
-	Midi_mt32.syn->render((Bit16s*)MixTemp, (Bit32u)len);
+	Midi_mt32.UpdateThread();
+	Midi_mt32.Mix(len);
 	Midi_mt32.chan->AddSamples_s16(len, (Bit16s*)MixTemp);
 }
@@ -28,15 +28,119 @@
 #include "tsf.h"
 
 static void MIDI_TSF_CallBack(Bitu len);
+extern Bit32u dbp_midi_polyphony;
+extern bool dbp_midi_tsf_threads;
+
+// Splits the rendering of the active voices across worker threads, each renders its share of a whole mix into its own buffer which get summed up at the end
+struct MidiTSFWorkers
+{
+	enum { MAX_THREADS = 7, MIN_VOICES_PER_THREAD = 8, MAX_SAMPLES = MIXER_BUFSIZE/4 };
+	tsf* sf;
+	struct tsf_voice** voices;
+	Bit32u threads, voices_cap, split[MAX_THREADS + 2], samples;
+	float* bufs;
+	Semaphore *begin, *done;
+	volatile bool active;
+
+	void Shutdown()
+	{
+		if (!active) return;
+		active = false;
+		for (Bit32u i = 0; i != threads; i++) begin[i].Post();
+		for (Bit32u i = 0; i != threads; i++) done[i].Wait();
+		delete [] begin;
+		delete [] done;
+		free(bufs);
+		free(voices);
+		voices = NULL;
+		voices_cap = 0;
+	}
+
+	void RenderPart(Bit32u part)
+	{
+		float* buf = bufs + part * MAX_SAMPLES * 2;
+		memset(buf, 0, samples * 2 * sizeof(float));
+		for (Bit32u i = split[part]; i != split[part + 1]; i++)
+			tsf_voice_render(sf, voices[i], buf, (int)samples);
+	}
+
+	static Thread::RET_t THREAD_CC WorkerThread(void* p);
+
+	void Render(tsf* f, Bit16s* out, Bitu len)
+	{
+		if (!dbp_midi_tsf_threads || f->outputmode != TSF_STEREO_INTERLEAVED || len > MAX_SAMPLES)
+		{
+			tsf_render_short(f, out, (int)len, 0);
+			return;
+		}
+		if ((Bit32u)f->voiceNum > voices_cap) voices = (struct tsf_voice**)realloc(voices, (voices_cap = (Bit32u)f->voiceNum) * sizeof(struct tsf_voice*));
+		Bit32u count = 0;
+		for (struct tsf_voice *v = f->voices, *vEnd = v + f->voiceNum; v != vEnd; v++)
+			if (v->playingPreset != -1) voices[count++] = v;
+
+		// Don't wake up threads for just a few voices
+		Bit32u use = count / MIN_VOICES_PER_THREAD;
+		if (use <= 1)
+		{
+			tsf_render_short(f, out, (int)len, 0);
+			return;
+		}
+		if (!active)
+		{
+			extern unsigned dbp_cpu_features_get_core_amount(void);
+			unsigned cores = dbp_cpu_features_get_core_amount();
+			threads = (cores <= (MAX_THREADS+1) ? (cores ? cores - 1 : 0) : MAX_THREADS);
+			if (!threads) { tsf_render_short(f, out, (int)len, 0); return; }
+			active = true;
+			begin = new Semaphore[threads];
+			done = new Semaphore[threads];
+			bufs = (float*)malloc((threads + 1) * MAX_SAMPLES * 2 * sizeof(float));
+			for (Bit32u i = 0; i != threads; i++) Thread::StartDetached(WorkerThread, (void*)(size_t)i);
+		}
+		if (use > threads + 1) use = threads + 1;
+		for (Bit32u i = 0; i <= use; i++) split[i] = count * i / use;
+		sf = f;
+		samples = (Bit32u)len;
+
+		// Parts 1 and up are rendered by worker threads, part 0 on this thread (voices render in the same blocks of samples as tsf_render_short)
+		for (Bit32u i = 1; i != use; i++) begin[i - 1].Post();
+		RenderPart(0);
+		for (Bit32u i = 1; i != use; i++) done[i - 1].Wait();
+
+		float *sum = bufs, *sumEnd = sum + len * 2;
+		for (Bit32u i = 1; i != use; i++)
+			for (float *a = sum, *b = bufs + i * MAX_SAMPLES * 2; a != sumEnd;) *(a++) += *(b++);
+		Bit16s* o = out;
+		for (float* a = sum; a != sumEnd; a++)
+			*(o++) = (*a < -1.00004566f ? (Bit16s)-32768 : (*a > 1.00001514f ? (Bit16s)32767 : (Bit16s)(*a * 32767.5f)));
+	}
+};
+static MidiTSFWorkers Midi_tsf_workers;
+
+Thread::RET_t THREAD_CC MidiTSFWorkers::WorkerThread(void* p)
+{
+	MidiTSFWorkers& w = Midi_tsf_workers;
+	for (Bit32u tnum = (Bit32u)(size_t)p;;)
+	{
+		// Only check active after being woken up, Shutdown always waits for a final post
+		w.begin[tnum].Wait();
+		bool run = w.active;
+		if (run)
+			w.RenderPart(tnum + 1);
+		w.done[tnum].Post();
+		if (!run) return 0;
+	}
+}
 
 struct MidiHandler_tsf : public MidiHandler
 {
-	MidiHandler_tsf() : MidiHandler(), chan(NULL), mo(NULL), f(NULL), sf(NULL) {}
+	MidiHandler_tsf() : MidiHandler(), chan(NULL), mo(NULL), f(NULL), sf(NULL), polyphony(0) {}
 	MixerChannel* chan;
 	MixerObject*  mo;
 	DOS_File*     f;
 	DOS_Drive*    d_zip;
 	tsf*          sf;
+	Bit32u        polyphony;
 
 	const char * GetName(void) { return "tsf"; };
 
@@ -82,6 +186,7 @@ struct MidiHandler_tsf : public MidiHandler
 	{
 		if (f)      { f->Close();delete f; f      = NULL; }
 		if (d_zip)  { delete d_zip;        d_zip  = NULL; }
+		Midi_tsf_workers.Shutdown();
 		if (sf)     { tsf_close(sf);       sf     = NULL; }
 		if (chan)   { chan->Enable(false); chan   = NULL; }
 		if (mo)     { delete mo;           mo     = NULL; } // also deletes chan!
@@ -93,28 +198,60 @@ struct MidiHandler_tsf : public MidiHandler
 		for (Bit16u read; sz; sz -= read, p += read) { read = (Bit16u)(sz > 0xFFFF ? 0xFFFF : sz); if (!f->Read(p, &read) || !read) return false; }
 		return true;
 	}
+	static int tsf_stream_dosfile_read_at(DOS_File* f, unsigned int pos, Bit8u* p, unsigned int sz)
+	{
+		Bit32u seek = pos;
+		return ((f->Seek(&seek, DOS_SEEK_SET) && seek == pos && tsf_stream_dosfile_read(f, p, sz)) ? (int)sz : 0);
+	}
 
 	bool LoadFont()
 	{
 		if (sf) return true;
 		if (!f) return false;
+		// Only the presets are loaded here, sample data is read from the still open file when a note or program change needs it
 		struct tsf_stream stream = { f, (int(*)(void*,void*,unsigned int))&tsf_stream_dosfile_read, (int(*)(void*,unsigned int))&tsf_stream_dosfile_skip };
-		sf = tsf_load(&stream);
-		f->Close();
-		delete f;
-		f = NULL;
-		if (d_zip) { delete d_zip; d_zip = NULL; }
-		if (!sf) return false;
+		sf = tsf_load_lazy(&stream, f, (int(*)(void*,unsigned int,void*,unsigned int))&tsf_stream_dosfile_read_at);
+		if (!sf)
+		{
+			f->Close();
+			delete f;
+			f = NULL;
+			if (d_zip) { delete d_zip; d_zip = NULL; }
+			return false;
+		}
 
 		//Initialize preset on special 10th MIDI channel to use percussion sound bank (128) if available
 		tsf_channel_set_bank_preset(sf, 9, 128, 0);
 
 		extern Bit32u DBP_MIXER_GetFrequency();
 		tsf_set_output(sf, TSF_STEREO_INTERLEAVED, (int)DBP_MIXER_GetFrequency(), 0.0);
+		ApplyPolyphony();
 		chan->Enable(true);
 		return true;
 	}
 
+	void ApplyPolyphony()
+	{
+		// The limit can change while playing, lowering it below the allocated voices ends the oldest ones and moves the rest to the front
+		polyphony = dbp_midi_polyphony;
+		if (!polyphony) { sf->maxVoiceNum = 0; return; } // allocate more voices as needed again
+		if ((int)polyphony >= sf->voiceNum) { tsf_set_max_voices(sf, (int)polyphony); return; }
+		struct tsf_voice *v, *vBegin = sf->voices, *vEnd = vBegin + sf->voiceNum, *trg;
+		Bit32u playing = 0;
+		for (v = vBegin; v != vEnd; v++) if (v->playingPreset != -1) playing++;
+		for (; playing > polyphony; playing--)
+		{
+			struct tsf_voice* oldest = NULL;
+			for (v = vBegin; v != vEnd; v++)
+				if (v->playingPreset != -1 && (!oldest || (sf->voicePlayIndex - v->playIndex) > (sf->voicePlayIndex - oldest->playIndex)))
+					oldest = v;
+			tsf_voice_kill(oldest);
+		}
+		for (v = trg = vBegin; v != vEnd; v++) if (v->playingPreset != -1) { if (trg != v) *trg = *v; trg++; }
+		for (; trg != vBegin + polyphony; trg++) trg->playingPreset = -1;
+		sf->voiceNum = sf->maxVoiceNum = (int)polyphony;
+	}
+
 	void PlayMsg(Bit8u * msg)
 	{
 		if (!sf && (!f || !LoadFont())) return;
@@ -126,6 +263,7 @@ struct MidiHandler_tsf : public MidiHandler
 			case 0xC0: //channel program (preset) change (special handling for 10th MIDI channel with drums)
 //				printf("[MIDI] Channel %2d PRESET %3d\n", channel, msg[1]);
 				tsf_channel_set_presetnumber(sf, channel, msg[1], (channel == 9));
+				tsf_preload_preset(sf, tsf_channel_get_preset_index(sf, channel));
 				break;
 			case 0x90: //play a note
 //				printf("[MIDI] Channel %2d NOTE %3d AT VEL %3d\n", channel, msg[1], msg[2]);
@@ -164,7 +302,8 @@ static void MIDI_TSF_CallBack(Bitu len)
 {
 	DBP_ASSERT(len <= (MIXER_BUFSIZE/4));
 	if (len > (MIXER_BUFSIZE/4)) len = (MIXER_BUFSIZE/4);
-	tsf_render_short(Midi_tsf.sf, (Bit16s*)MixTemp, (int)len, 0);
+	if (Midi_tsf.polyphony != dbp_midi_polyphony) Midi_tsf.ApplyPolyphony();
+	Midi_tsf_workers.Render(Midi_tsf.sf, (Bit16s*)MixTemp, len);
 	Midi_tsf.chan->AddSamples_s16(len, (Bit16s*)MixTemp);
 }
 
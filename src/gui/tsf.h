@@ -89,6 +89,14 @@ struct tsf_stream
 // Generic SoundFont loading method using the stream structure above
 TSFDEF tsf* tsf_load(struct tsf_stream* stream);
 
+// Load only the preset definitions from the stream and read sample data on demand when a note needs it.
+// Function pointer 'read_at' reads 'size' bytes at absolute position 'pos' into ptr (returns number of read bytes),
+// it is kept and called until tsf_close. Fonts with compressed samples get fully loaded during this call.
+TSFDEF tsf* tsf_load_lazy(struct tsf_stream* stream, void* read_at_data, int (*read_at)(void* data, unsigned int pos, void* ptr, unsigned int size));
+
+// Load the sample data used by all regions of a preset (returns 0 if a sample could not be read)
+TSFDEF int tsf_preload_preset(tsf* f, int preset_index);
+
 // Copy a tsf instance from an existing one, use tsf_close to close it as well.
 // All copied tsf instances and their original instance are linked, and share the underlying soundfont.
 // This allows loading a soundfont only once, but using it for multiple independent playbacks.
@@ -331,6 +339,11 @@ struct tsf
 {
 	struct tsf_preset* presets;
 	float* fontSamples;
+	struct tsf_sample* samples;
+	int sampleNum;
+	unsigned int smplPos, smplCount;
+	void* readAtData;
+	int (*readAt)(void* data, unsigned int pos, void* ptr, unsigned int size);
 	struct tsf_voice* voices;
 	struct tsf_channels* channels;
 
@@ -438,8 +451,12 @@ struct tsf_region
 	int freqModLFO, modLfoToPitch;
 	float delayVibLFO;
 	int freqVibLFO, vibLfoToPitch;
+	unsigned int sample_index;
 };
 
+// Sample data of a lazy loaded font, covering the range used by all regions referencing the sample header
+struct tsf_sample { float* data; unsigned int first, last; };
+
 struct tsf_preset
 {
 	tsf_char20 presetName;
@@ -822,6 +839,7 @@ static int tsf_load_presets(tsf* res, struct tsf_hydra *hydra, unsigned int font
 
 								// Fixup sample positions
 								pshdr = &hydra->shdrs[pigen->genAmount.wordAmount];
+								zoneRegion.sample_index = pigen->genAmount.wordAmount;
 								zoneRegion.offset += pshdr->start;
 								zoneRegion.end += pshdr->end;
 								zoneRegion.loop_start += pshdr->startLoop;
@@ -1002,6 +1020,70 @@ static int tsf_load_samples(void** pRawBuffer, float** pFloatBuffer, unsigned in
 	#endif
 }
 
+struct tsf_stream_lazy { struct tsf_stream* stream; unsigned int pos, smplPos, smplSize; };
+static int tsf_stream_lazy_read(struct tsf_stream_lazy* l, void* ptr, unsigned int size) { int res = l->stream->read(l->stream->data, ptr, size); if (res) l->pos += size; return res; }
+static int tsf_stream_lazy_skip(struct tsf_stream_lazy* l, unsigned int count) { l->pos += count; return l->stream->skip(l->stream->data, count); }
+
+static int tsf_setup_lazy_samples(tsf* res, int shdrNum)
+{
+	struct tsf_preset *preset, *presetEnd;
+	struct tsf_region *region, *regionEnd;
+	struct tsf_sample *s, *sEnd;
+	res->samples = (struct tsf_sample*)TSF_MALLOC(shdrNum * sizeof(struct tsf_sample));
+	if (!res->samples) return 0;
+	res->sampleNum = shdrNum;
+	for (s = res->samples, sEnd = s + shdrNum; s != sEnd; s++) { s->data = TSF_NULL; s->first = (unsigned int)-1; s->last = 0; }
+
+	// Find the range of sample data used by any region, loop points only count if the region can loop
+	for (preset = res->presets, presetEnd = preset + res->presetNum; preset != presetEnd; preset++)
+	{
+		for (region = preset->regions, regionEnd = region + preset->regionNum; region != regionEnd; region++)
+		{
+			s = &res->samples[region->sample_index];
+			if (region->loop_start >= region->loop_end) region->loop_start = region->loop_end = region->offset;
+			if (region->offset < s->first) s->first = region->offset;
+			if (region->loop_start < s->first) s->first = region->loop_start;
+			if (region->end > s->last) s->last = region->end;
+			if (region->loop_end > s->last) s->last = region->loop_end;
+		}
+	}
+
+	// Make the region sample positions relative to the start of the sample data
+	for (preset = res->presets, presetEnd = preset + res->presetNum; preset != presetEnd; preset++)
+	{
+		for (region = preset->regions, regionEnd = region + preset->regionNum; region != regionEnd; region++)
+		{
+			unsigned int first = res->samples[region->sample_index].first;
+			region->offset -= first;
+			region->end -= first;
+			region->loop_start -= first;
+			region->loop_end -= first;
+		}
+	}
+	return 1;
+}
+
+static int tsf_load_lazy_sample(tsf* f, struct tsf_sample* s)
+{
+	unsigned int num = s->last - s->first + 2, avail = (s->first < f->smplCount ? f->smplCount - s->first : 0);
+	float *res, *out; const short *in;
+	if (s->data) return 1;
+	if (avail > num) avail = num;
+	res = (float*)TSF_MALLOC(num * sizeof(float));
+	if (!res) return 0;
+	if (avail && f->readAt(f->readAtData, f->smplPos + s->first * (unsigned int)sizeof(short), res, avail * (unsigned int)sizeof(short)) != (int)(avail * sizeof(short)))
+	{
+		TSF_FREE(res);
+		return 0;
+	}
+
+	// Inline convert the samples from short to float and clear what is past the end of the sample data
+	for (out = res + num; out != res + avail;) *(--out) = 0.0f;
+	for (in = (short*)res + avail; out != res;) *(--out) = (float)(*(--in) / 32767.0);
+	s->data = res;
+	return 1;
+}
+
 static int tsf_voice_envelope_release_samples(struct tsf_voice_envelope* e, float outSampleRate)
 {
 	return (int)((e->parameters.release <= 0 ? TSF_FASTRELEASETIME : e->parameters.release) * outSampleRate);
@@ -1220,7 +1302,7 @@ static void tsf_voice_calcpitchratio(struct tsf_voice* v, float pitchShift, floa
 static void tsf_voice_render(tsf* f, struct tsf_voice* v, float* outputBuffer, int numSamples)
 {
 	struct tsf_region* region = v->region;
-	float* input = f->fontSamples;
+	float* input = (f->samples ? f->samples[region->sample_index].data : f->fontSamples);
 	float* outL = outputBuffer;
 	float* outR = (f->outputmode == TSF_STEREO_UNWEAVED ? outL + numSamples : TSF_NULL);
 
@@ -1358,7 +1440,7 @@ static void tsf_voice_render(tsf* f, struct tsf_voice* v, float* outputBuffer, i
 	if (tmpLowpass.active || dynamicLowpass) v->lowpass = tmpLowpass;
 }
 
-TSFDEF tsf* tsf_load(struct tsf_stream* stream)
+static tsf* tsf_load_internal(struct tsf_stream* stream, void* readAtData, int (*readAt)(void* data, unsigned int pos, void* ptr, unsigned int size))
 {
 	tsf* res = TSF_NULL;
 	struct tsf_riffchunk chunkHead;
@@ -1367,6 +1449,9 @@ TSFDEF tsf* tsf_load(struct tsf_stream* stream)
 	void* rawBuffer = TSF_NULL;
 	float* floatBuffer = TSF_NULL;
 	tsf_u32 smplCount = 0;
+	struct tsf_stream_lazy lazy = { stream, 0, 0, 0 };
+	struct tsf_stream lazyStream = { &lazy, (int(*)(void*,void*,unsigned int))&tsf_stream_lazy_read, (int(*)(void*,unsigned int))&tsf_stream_lazy_skip };
+	if (readAt) stream = &lazyStream; // track the position in the stream to know where the sample data is
 
 	if (!tsf_riffchunk_read(TSF_NULL, &chunkHead, stream) || !TSF_FourCCEquals(chunkHead.id, "sfbk"))
 	{
@@ -1412,9 +1497,16 @@ TSFDEF tsf* tsf_load(struct tsf_stream* stream)
 						#ifdef STB_VORBIS_INCLUDE_STB_VORBIS_H
 						|| TSF_FourCCEquals(chunk.id, "smpo")
 						#endif
-					) && !rawBuffer && !floatBuffer && chunk.size >= sizeof(short))
+					) && !rawBuffer && !floatBuffer && !lazy.smplSize && chunk.size >= sizeof(short))
 				{
-					if (!tsf_load_samples(&rawBuffer, &floatBuffer, &smplCount, &chunk, stream)) goto out_of_memory;
+					if (readAt && chunk.id[3] == 'l')
+					{
+						// Remember where the sample data is and read it later when needed
+						lazy.smplPos = lazy.pos;
+						lazy.smplSize = chunk.size;
+						stream->skip(stream->data, chunk.size);
+					}
+					else if (!tsf_load_samples(&rawBuffer, &floatBuffer, &smplCount, &chunk, stream)) goto out_of_memory;
 				}
 				else stream->skip(stream->data, chunk.size);
 			}
@@ -1425,20 +1517,39 @@ TSFDEF tsf* tsf_load(struct tsf_stream* stream)
 	{
 		//if (e) *e = TSF_INVALID_INCOMPLETE;
 	}
-	else if (!rawBuffer && !floatBuffer)
+	else if (!rawBuffer && !floatBuffer && !lazy.smplSize)
 	{
 		//if (e) *e = TSF_INVALID_NOSAMPLEDATA;
 	}
 	else
 	{
 		#ifdef STB_VORBIS_INCLUDE_STB_VORBIS_H
-		if (!floatBuffer && !tsf_decode_sf3_samples(rawBuffer, &floatBuffer, &smplCount, &hydra)) goto out_of_memory;
+		if (lazy.smplSize)
+		{
+			// Compressed samples can't be loaded on demand, read all the sample data now
+			int i;
+			for (i = 0; i != hydra.shdrNum; i++) if (hydra.shdrs[i].sampleType & 0x30) break;
+			if (i != hydra.shdrNum)
+			{
+				smplCount = lazy.smplSize;
+				rawBuffer = (void*)TSF_MALLOC(smplCount);
+				if (!rawBuffer || readAt(readAtData, lazy.smplPos, rawBuffer, smplCount) != (int)smplCount) goto out_of_memory;
+				lazy.smplSize = 0;
+			}
+		}
+		if (!floatBuffer && !lazy.smplSize && !tsf_decode_sf3_samples(rawBuffer, &floatBuffer, &smplCount, &hydra)) goto out_of_memory;
 		#endif
+		if (lazy.smplSize) smplCount = lazy.smplSize / (unsigned int)sizeof(short);
 		res = (tsf*)TSF_MALLOC(sizeof(tsf));
 		if (res) TSF_MEMSET(res, 0, sizeof(tsf));
 		if (!res || !tsf_load_presets(res, &hydra, smplCount)) goto out_of_memory;
+		if (lazy.smplSize && !tsf_setup_lazy_samples(res, hydra.shdrNum)) goto out_of_memory;
 		res->outSampleRate = 44100.0f;
 		res->fontSamples = floatBuffer;
+		res->smplPos = lazy.smplPos;
+		res->smplCount = smplCount;
+		res->readAtData = readAtData;
+		res->readAt = readAt;
 		floatBuffer = TSF_NULL; // don't free below
 	}
 	if (0)
@@ -1455,6 +1566,26 @@ TSFDEF tsf* tsf_load(struct tsf_stream* stream)
 	return res;
 }
 
+TSFDEF tsf* tsf_load(struct tsf_stream* stream)
+{
+	return tsf_load_internal(stream, TSF_NULL, TSF_NULL);
+}
+
+TSFDEF tsf* tsf_load_lazy(struct tsf_stream* stream, void* read_at_data, int (*read_at)(void* data, unsigned int pos, void* ptr, unsigned int size))
+{
+	return tsf_load_internal(stream, read_at_data, read_at);
+}
+
+TSFDEF int tsf_preload_preset(tsf* f, int preset_index)
+{
+	struct tsf_region *region, *regionEnd;
+	int res = 1;
+	if (preset_index < 0 || preset_index >= f->presetNum || !f->samples) return res;
+	for (region = f->presets[preset_index].regions, regionEnd = region + f->presets[preset_index].regionNum; region != regionEnd; region++)
+		if (!tsf_load_lazy_sample(f, &f->samples[region->sample_index])) res = 0;
+	return res;
+}
+
 TSFDEF tsf* tsf_copy(tsf* f)
 {
 	tsf* res;
@@ -1484,6 +1615,12 @@ TSFDEF void tsf_close(tsf* f)
 		for (; preset != presetEnd; preset++) TSF_FREE(preset->regions);
 		TSF_FREE(f->presets);
 		TSF_FREE(f->fontSamples);
+		if (f->samples)
+		{
+			struct tsf_sample *s = f->samples, *sEnd = s + f->sampleNum;
+			for (; s != sEnd; s++) TSF_FREE(s->data);
+			TSF_FREE(f->samples);
+		}
 		TSF_FREE(f->refCount);
 	}
 	TSF_FREE(f->channels);
@@ -1565,6 +1702,7 @@ TSFDEF int tsf_note_on(tsf* f, int preset_index, int key, float vel)
 	{
 		struct tsf_voice *voice, *v, *vEnd; TSF_BOOL doLoop; float lowpassFilterQDB, lowpassFc;
 		if (key < region->lokey || key > region->hikey || midiVelocity < region->lovel || midiVelocity > region->hivel) continue;
+		if (f->samples && !tsf_load_lazy_sample(f, &f->samples[region->sample_index])) continue;
 
 		voice = TSF_NULL, v = f->voices, vEnd = v + f->voiceNum;
 		if (region->group)
@@ -1595,7 +1733,14 @@ TSFDEF int tsf_note_on(tsf* f, int preset_index, int key, float vel)
 					}
 				}
 				if (!voice)
-					continue;
+				{
+					// Nothing is releasing, steal the voice that has been playing the longest
+					for (v = f->voices; v != vEnd; v++)
+						if (v->playIndex != voicePlayIndex && (!voice || (voicePlayIndex - v->playIndex) > (voicePlayIndex - voice->playIndex)))
+							voice = v;
+					if (!voice)
+						continue;
+				}
 				tsf_voice_kill(voice);
 			}
 			else
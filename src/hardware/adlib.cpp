@@ -28,6 +28,7 @@
 #include "mem.h"
 #include "dbopl.h"
 #include "cpu.h"
+#include "dbp_threads.h"
 
 #ifdef C_DBP_ENABLE_NUKEDOPL3
 #include "nukedopl3.h"
@@ -185,6 +186,21 @@ namespace Adlib {
 //DBP: moved out of dynamically allocated data into static so it preserves across runtime config modifications
 static RegisterCache cache;
 
+//DBP: When rendering on a separate thread, the chip renders ahead into a ring buffer up to a fixed latency past the consumed output.
+//Register writes get logged with the output position at that latency so the render thread applies them at the exact sample which keeps output deterministic.
+//Timers and status reads are emulated by Chip on the emulation thread and don't depend on the rendered output.
+static struct OPLThread {
+	enum { RING_SIZE = 16384, RING_MASK = RING_SIZE - 1, LOG_SIZE = 4096, LOG_MASK = LOG_SIZE - 1, MAX_MIX_LEN = MIXER_BUFSIZE/4, RENDER_CHUNK = 512 };
+	struct Write { Bit32u pos; Bit16u reg; Bit8u val; };
+	Handler* handler;
+	Bit32s* ring;
+	Write log[LOG_SIZE];
+	Bit32u ring_rendered, ring_consumed, ring_target, ring_ahead, log_read, log_write, log_pos, rate, ms;
+	bool active, run, hold, held;
+	Mutex mutex;
+	Semaphore sem_work, sem_done;
+} thread;
+
 /* Raw DRO capture stuff */
 
 #ifdef _MSC_VER
@@ -536,7 +552,7 @@ void Module::DualWrite( Bit8u index, Bit8u reg, Bit8u val ) {
 		val |= index ? 0xA0 : 0x50;
 	}
 	Bit32u fullReg = reg + (index ? 0x100 : 0);
-	handler->WriteReg( fullReg, val );
+	HandlerWrite( fullReg, val );
 	CacheWrite( fullReg, val );
 }
 
@@ -571,6 +587,37 @@ Bitu Module::CtrlRead( void ) {
 }
 
 
+Bit32u Module::WriteAddr( Bitu port, Bitu val ) {
+	//The handler state which decides the register bank is updated late by the render thread, decide it with the register cache instead
+	if ( thread.active ) {
+		return ( ( port & 2 ) && ( val == 0x05 || ( cache[0x105] & 1 ) ) ? 0x100 | val : val );
+	}
+	return handler->WriteAddr( (Bit32u)port, (Bit8u)val );
+}
+
+void Module::HandlerWrite( Bit32u reg, Bit8u val ) {
+	if ( !thread.active ) {
+		handler->WriteReg( reg, val );
+		return;
+	}
+	//Output position one latency past the emulated current time, kept in order for writes within the same sample
+	Bit32u pos = thread.ring_consumed + thread.ring_ahead + (Bit32u)(PIC_TickIndex() * thread.rate / 1000);
+	if ( (Bit32s)(pos - thread.log_pos) < 0 ) pos = thread.log_pos;
+	thread.log_pos = pos;
+	thread.mutex.Lock();
+	while ( thread.log_write - thread.log_read == thread.LOG_SIZE ) {
+		//Log is full, let the render thread catch up to the logged writes
+		if ( (Bit32s)(pos - thread.ring_target) > 0 ) thread.ring_target = pos;
+		thread.mutex.Unlock();
+		thread.sem_work.Post();
+		thread.sem_done.Wait();
+		thread.mutex.Lock();
+	}
+	thread.log[thread.log_write & thread.LOG_MASK] = { pos, (Bit16u)reg, val };
+	thread.log_write++;
+	thread.mutex.Unlock();
+}
+
 void Module::PortWrite( Bitu port, Bitu val, Bitu /*iolen*/ ) {
 	//Keep track of last write time
 	lastUsed = PIC_Ticks;
@@ -591,7 +638,7 @@ void Module::PortWrite( Bitu port, Bitu val, Bitu /*iolen*/ ) {
 		case MODE_OPL2:
 		case MODE_OPL3:
 			if ( !chip[0].Write( reg.normal, val ) ) {
-				handler->WriteReg( reg.normal, val );
+				HandlerWrite( reg.normal, val );
 				CacheWrite( reg.normal, val );
 			}
 			break;
@@ -612,7 +659,7 @@ void Module::PortWrite( Bitu port, Bitu val, Bitu /*iolen*/ ) {
 		//Make sure to clip them in the right range
 		switch ( mode ) {
 		case MODE_OPL2:
-			reg.normal = handler->WriteAddr( port, val ) & 0xff;
+			reg.normal = WriteAddr( port, val ) & 0xff;
 			break;
 		case MODE_OPL3GOLD:
 			if ( port == 0x38a ) {
@@ -629,7 +676,7 @@ void Module::PortWrite( Bitu port, Bitu val, Bitu /*iolen*/ ) {
 			} //Fall-through if not handled by control chip
 			/* FALLTHROUGH */
 		case MODE_OPL3:
-			reg.normal = handler->WriteAddr( port, val ) & 0x1ff;
+			reg.normal = WriteAddr( port, val ) & 0x1ff;
 			break;
 		case MODE_DUALOPL2:
 			//Not a 0x?88 port, when write to a specific side
@@ -699,7 +746,7 @@ void Module::Init( Mode m ) {
 		break;
 	case MODE_DUALOPL2:
 		//Setup opl3 mode in the hander
-		handler->WriteReg( 0x105, 1 );
+		HandlerWrite( 0x105, 1 );
 		//Also set it up in the cache so the capturing will start opl3
 		CacheWrite( 0x105, 1 );
 		break;
@@ -712,8 +759,143 @@ void Module::Init( Mode m ) {
 
 static Adlib::Module* module = 0;
 
+Bit32u dbp_opl_thread_ms;
+
+static Thread::RET_t THREAD_CC OPL_RenderThread(void*) {
+	using Adlib::thread;
+	for (;;) {
+		thread.mutex.Lock();
+		Bit32u from = thread.ring_rendered, n = thread.ring_target - from, rd = thread.log_read, wr = thread.log_write;
+		bool run = thread.run, hold = thread.hold;
+		if (hold) thread.held = true;
+		thread.mutex.Unlock();
+		if (!run) break;
+		if (hold) { thread.sem_done.Post(); thread.sem_work.Wait(); continue; }
+		if (n > thread.RING_SIZE) n = 0; //target is behind after a catch up
+
+		//Apply the writes that are due and render up to the next one
+		Bit32u rd_begin = rd;
+		for (; rd != wr; rd++) {
+			const Adlib::OPLThread::Write& w = thread.log[rd & thread.LOG_MASK];
+			if ((Bit32s)(w.pos - from) > 0) {
+				if (n > w.pos - from) n = w.pos - from;
+				break;
+			}
+			thread.handler->WriteReg(w.reg, w.val);
+		}
+		if (!n && rd == rd_begin) { thread.sem_work.Wait(); continue; }
+
+		Bit32u ofs = (from & thread.RING_MASK);
+		if (n > thread.RING_SIZE - ofs) n = thread.RING_SIZE - ofs;
+		if (n > thread.RENDER_CHUNK) n = thread.RENDER_CHUNK;
+		if (n) thread.handler->Render(thread.ring + ofs * 2, n);
+
+		thread.mutex.Lock();
+		thread.ring_rendered = from + n;
+		thread.log_read = rd;
+		thread.mutex.Unlock();
+		thread.sem_done.Post();
+	}
+	thread.mutex.Lock();
+	thread.active = false;
+	thread.mutex.Unlock();
+	thread.sem_done.Post();
+	return 0;
+}
+
+static void OPL_StopThread() {
+	using Adlib::thread;
+	thread.ms = 0;
+	if (!thread.active) return;
+	thread.mutex.Lock();
+	thread.run = false;
+	thread.mutex.Unlock();
+	for (thread.sem_work.Post(); thread.active;) thread.sem_done.Wait();
+	//Apply writes that were logged but not yet reached so the handler has the latest state
+	for (; thread.log_read != thread.log_write; thread.log_read++)
+		thread.handler->WriteReg(thread.log[thread.log_read & thread.LOG_MASK].reg, thread.log[thread.log_read & thread.LOG_MASK].val);
+}
+
+//Halt the render thread without ending it so the handler can be modified directly (i.e. on state load), then resume it with an empty ring
+static void OPL_HoldThread() {
+	using Adlib::thread;
+	if (!thread.active) return;
+	thread.mutex.Lock();
+	thread.hold = true;
+	thread.held = false;
+	thread.mutex.Unlock();
+	thread.sem_work.Post();
+	for (;;) {
+		thread.mutex.Lock();
+		bool held = thread.held;
+		thread.mutex.Unlock();
+		if (held) break;
+		thread.sem_done.Wait();
+	}
+	for (; thread.log_read != thread.log_write; thread.log_read++)
+		thread.handler->WriteReg(thread.log[thread.log_read & thread.LOG_MASK].reg, thread.log[thread.log_read & thread.LOG_MASK].val);
+}
+
+static void OPL_ReleaseThread() {
+	using Adlib::thread;
+	if (!thread.active) return;
+	thread.mutex.Lock();
+	thread.ring_rendered = thread.ring_consumed = thread.log_read = thread.log_write = 0;
+	thread.ring_target = thread.log_pos = thread.ring_ahead;
+	thread.hold = false;
+	thread.mutex.Unlock();
+	thread.sem_work.Post();
+}
+
+static void OPL_UpdateThread() {
+	using Adlib::thread;
+	if (thread.ms == dbp_opl_thread_ms) return;
+	OPL_StopThread();
+	thread.handler = module->handler;
+	if (!(thread.ms = dbp_opl_thread_ms) || !thread.handler->Render(NULL, 0)) return;
+	if (!thread.ring) thread.ring = new Bit32s[thread.RING_SIZE * 2];
+	thread.ring_ahead = (Bit32u)((Bit64u)thread.rate * thread.ms / 1000);
+	//Keep room for the largest mix and for the writes logged during one tick
+	if (thread.ring_ahead > thread.RING_SIZE - thread.MAX_MIX_LEN * 2) thread.ring_ahead = thread.RING_SIZE - thread.MAX_MIX_LEN * 2;
+	thread.ring_rendered = thread.ring_consumed = thread.log_read = thread.log_write = 0;
+	thread.ring_target = thread.log_pos = thread.ring_ahead;
+	thread.hold = false;
+	thread.active = thread.run = true;
+	Thread::StartDetached(OPL_RenderThread);
+}
+
+static void OPL_MixThread(Bitu len) {
+	using Adlib::thread;
+	//Make sure the render thread is at least len samples ahead, then take them out of the ring buffer
+	thread.mutex.Lock();
+	if ((Bit32s)(thread.ring_consumed + len - thread.ring_target) > 0) thread.ring_target = thread.ring_consumed + (Bit32u)len;
+	thread.mutex.Unlock();
+	thread.sem_work.Post();
+	for (;;) {
+		thread.mutex.Lock();
+		bool ready = (thread.ring_rendered - thread.ring_consumed >= len);
+		thread.mutex.Unlock();
+		if (ready) break;
+		thread.sem_done.Wait();
+	}
+	Bit32u ofs = (thread.ring_consumed & thread.RING_MASK), first = thread.RING_SIZE - ofs;
+	if (first > len) first = (Bit32u)len;
+	module->mixerChan->AddSamples_s32(first, thread.ring + ofs * 2);
+	if (len > first) module->mixerChan->AddSamples_s32(len - first, thread.ring);
+
+	thread.mutex.Lock();
+	thread.ring_consumed += (Bit32u)len;
+	if ((Bit32s)(thread.ring_consumed + thread.ring_ahead - thread.ring_target) > 0) thread.ring_target = thread.ring_consumed + thread.ring_ahead;
+	thread.mutex.Unlock();
+	thread.sem_work.Post();
+}
+
 static void OPL_CallBack(Bitu len) {
-	module->handler->Generate( module->mixerChan, len );
+	OPL_UpdateThread();
+	if (!Adlib::thread.active)
+		module->handler->Generate( module->mixerChan, len );
+	else for (Bitu todo; len; len -= todo)
+		OPL_MixThread((todo = (len > Adlib::thread.MAX_MIX_LEN ? Adlib::thread.MAX_MIX_LEN : len)));
 	//Disable the sound generation after 30 seconds of silence
 	if ((PIC_Ticks - module->lastUsed) > 30000) {
 		Bitu i;
@@ -821,6 +1003,7 @@ Module::Module( Section* configuration ) : Module_base(configuration) {
 #endif
 
 	mixerChan = mixerObject.Install(OPL_CallBack,rate,"FM");
+	thread.rate = (Bit32u)rate;
 	//Used to be 2.0, which was measured to be too high. Exact value depends on card/clone.
 	mixerChan->SetScale( 1.5f );  
 
@@ -888,6 +1071,7 @@ Module::Module( Section* configuration ) : Module_base(configuration) {
 }
 
 Module::~Module() {
+	OPL_StopThread();
 #ifdef C_DBP_ENABLE_CAPTURE
 	if ( capture ) {
 		delete capture;
@@ -942,9 +1126,11 @@ void DBPSerialize_OPL(DBPArchive& ar_outer)
 
 	if (ar.mode == DBPArchive::MODE_LOAD && module)
 	{
-		// Reset registers to their latest values
+		// Reset registers to their latest values, the render thread is held meanwhile and continues with an empty ring
+		OPL_HoldThread();
 		for (Bit32u i = 0; i != 512; i++)
 			module->handler->WriteReg(i, Adlib::cache[i]);
+		OPL_ReleaseThread();
 	}
 	if (ar.IsReset() && module)
 	{
@@ -140,6 +140,8 @@ public:
 	virtual void Generate( MixerChannel* chan, Bitu samples ) = 0;
 	//Initialize at a specific sample rate and mode
 	virtual void Init( Bitu rate ) = 0;
+	//DBP: Generate interleaved stereo samples into a buffer for the render thread, returns false if not supported (gets called with 0 samples to check)
+	virtual bool Render( Bit32s* /*out*/, Bitu /*samples*/ ) { return false; }
 	virtual ~Handler() {
 	}
 };
@@ -175,6 +177,7 @@ class Module: public Module_base {
 	void DualWrite( Bit8u index, Bit8u reg, Bit8u val );
 	void CtrlWrite( Bit8u val );
 	Bitu CtrlRead( void );
+	Bit32u WriteAddr( Bitu port, Bitu val );
 public:
 	static OPL_Mode oplmode;
 	MixerChannel* mixerChan;
@@ -189,6 +192,8 @@ public:
 
 	//Handle port writes
 	void PortWrite( Bitu port, Bitu val, Bitu iolen );
+	//DBP: Write a register to the handler, goes through the render thread while it is running
+	void HandlerWrite( Bit32u reg, Bit8u val );
 	Bitu PortRead( Bitu port, Bitu iolen );
 	void Init( Mode m );
 
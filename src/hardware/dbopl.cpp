@@ -1530,6 +1530,21 @@ void Handler::Generate( MixerChannel* chan, Bitu samples ) {
 	}
 }
 
+bool Handler::Render( Bit32s* out, Bitu samples ) {
+	DBP_ASSERT( samples <= 512 );
+	if ( !chip.opl3Active ) {
+		//Generate mono into the second half and spread it out to stereo front to back
+		Bit32s* mono = out + samples;
+		chip.GenerateBlock2( samples, mono );
+		for ( Bitu i = 0; i < samples; i++ ) {
+			out[i * 2] = out[i * 2 + 1] = mono[i];
+		}
+	} else {
+		chip.GenerateBlock3( samples, out );
+	}
+	return true;
+}
+
 void Handler::Init( Bitu rate ) {
 	InitTables();
 	chip.Setup( rate );
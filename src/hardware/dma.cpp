@@ -41,6 +41,15 @@ static void UpdateEMSMapping(void) {
 	}
 }
 
+//DBP: Translate a DMA page to the physical page taking care of the EMS pageframe etc.
+static INLINE Bitu DMA_TranslatePage(Bitu page) {
+	if (page < EMM_PAGEFRAME4K) return paging.firstmb[page];
+	else if (page < EMM_PAGEFRAME4K+0x10) return ems_board_mapping[page];
+	else if (page < LINK_START) return paging.firstmb[page];
+	return page;
+}
+
+//DBP: Copy whole runs inside a 4 KB page with memcpy instead of translating the page of every single byte
 /* read a block from physical memory */
 static void DMA_BlockRead(PhysPt spage,PhysPt offset,void * data,Bitu size,Bit8u dma16) {
 	Bit8u * write=(Bit8u *) data;
@@ -48,17 +57,17 @@ static void DMA_BlockRead(PhysPt spage,PhysPt offset,void * data,Bitu size,Bit8u
 	size <<= dma16;
 	offset <<= dma16;
 	Bit32u dma_wrap = ((0xffff<<dma16)+dma16) | dma_wrapping;
-	for ( ; size ; size--, offset++) {
+	while (size) {
 		if (offset>(dma_wrapping<<dma16)) {
 			LOG_MSG("DMA segbound wrapping (read): %x:%x size %" sBitfs(x) " [%x] wrap %x",spage,offset,size,dma16,dma_wrapping);
 		}
 		offset &= dma_wrap;
-		Bitu page = highpart_addr_page+(offset >> 12);
-		/* care for EMS pageframe etc. */
-		if (page < EMM_PAGEFRAME4K) page = paging.firstmb[page];
-		else if (page < EMM_PAGEFRAME4K+0x10) page = ems_board_mapping[page];
-		else if (page < LINK_START) page = paging.firstmb[page];
-		*write++=phys_readb(page*4096 + (offset & 4095));
+		Bitu run = 4096 - (offset & 4095);
+		if (run > size) run = size;
+		memcpy(write, MemBase + DMA_TranslatePage(highpart_addr_page+(offset >> 12))*4096 + (offset & 4095), run);
+		write += run;
+		offset += (PhysPt)run;
+		size -= run;
 	}
 }
 
@@ -69,17 +78,19 @@ static void DMA_BlockWrite(PhysPt spage,PhysPt offset,void * data,Bitu size,Bit8
 	size <<= dma16;
 	offset <<= dma16;
 	Bit32u dma_wrap = ((0xffff<<dma16)+dma16) | dma_wrapping;
-	for ( ; size ; size--, offset++) {
+	while (size) {
 		if (offset>(dma_wrapping<<dma16)) {
 			LOG_MSG("DMA segbound wrapping (write): %x:%x size %" sBitfs(x) " [%x] wrap %x",spage,offset,size,dma16,dma_wrapping);
 		}
 		offset &= dma_wrap;
-		Bitu page = highpart_addr_page+(offset >> 12);
-		/* care for EMS pageframe etc. */
-		if (page < EMM_PAGEFRAME4K) page = paging.firstmb[page];
-		else if (page < EMM_PAGEFRAME4K+0x10) page = ems_board_mapping[page];
-		else if (page < LINK_START) page = paging.firstmb[page];
-		phys_writeb(page*4096 + (offset & 4095), *read++);
+		Bitu run = 4096 - (offset & 4095);
+		if (run > size) run = size;
+		Bitu page = DMA_TranslatePage(highpart_addr_page+(offset >> 12));
+		MEM_SetPageDirty(page);
+		memcpy(MemBase + page*4096 + (offset & 4095), read, run);
+		read += run;
+		offset += (PhysPt)run;
+		size -= run;
 	}
 }
 
@@ -295,7 +306,7 @@ again:
 		curraddr+=want;
 		currcnt-=want;
 	} else {
-		DMA_BlockRead(pagebase,curraddr,buffer,want,DMA16);
+		DMA_BlockRead(pagebase,curraddr,buffer,left,DMA16);
 		buffer+=left << DMA16;
 		want-=left;
 		done+=left;
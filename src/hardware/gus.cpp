@@ -159,9 +159,9 @@ public:
 
 	// Returns a single 16-bit sample from the Gravis's RAM
 
-	INLINE Bit32s GetSample8() const {
+	template <bool interpolate> static INLINE Bit32s GetSample8(Bit32u WaveAddr) {
 		Bit32u useAddr = WaveAddr >> WAVE_FRACT;
-		if (WaveAdd >= (1 << WAVE_FRACT)) {
+		if (!interpolate) {
 			Bit32s tmpsmall = (Bit8s)GUSRam[useAddr];
 			return tmpsmall << 8;
 		}
@@ -176,14 +176,14 @@ public:
 		}
 	}
 
-	INLINE Bit32s GetSample16() const {
+	template <bool interpolate> static INLINE Bit32s GetSample16(Bit32u WaveAddr) {
 		Bit32u useAddr = WaveAddr >> WAVE_FRACT;
 		// Formula used to convert addresses for use with 16-bit samples
 		Bit32u holdAddr = useAddr & 0xc0000L;
 		useAddr = useAddr & 0x1ffffL;
 		useAddr = useAddr << 1;
 		useAddr = (holdAddr | useAddr);
-		if (WaveAdd >= (1 << WAVE_FRACT)) {
+		if (!interpolate) {
 			return (GUSRam[useAddr + 0] | (((Bit8s)GUSRam[useAddr + 1]) << 8));
 		}
 		else {
@@ -197,6 +197,12 @@ public:
 		}
 	}
 
+	INLINE Bit32s GetSample() const {
+		bool interpolate = (WaveAdd < (1 << WAVE_FRACT));
+		if (WaveCtrl & WCTRL_16BIT) return (interpolate ? GetSample16<true>(WaveAddr) : GetSample16<false>(WaveAddr));
+		else return (interpolate ? GetSample8<true>(WaveAddr) : GetSample8<false>(WaveAddr));
+	}
+
 	void WriteWaveFreq(Bit16u val) {
 		WaveAdd = ((Bit32u)val << (WAVE_FRACT-1)) / 512;        //Samples / original gus frame
 	}
@@ -310,21 +316,94 @@ public:
 		UpdateVolumes();
 	}
 
+	//DBP: Number of upcoming WaveUpdate calls that will not reach a boundary (start/end addresses are always below 1 << 29)
+	INLINE Bitu WaveRunLength(Bitu len) const {
+		if (WaveCtrl & (WCTRL_STOP | WCTRL_STOPPED)) return len;
+		// Same signed distance as WaveLeft in WaveUpdate
+		Bit32s left = (Bit32s)((WaveCtrl & WCTRL_DECREASING) ? (WaveAddr - WaveStart) : (WaveEnd - WaveAddr));
+		if (left <= 0) return 0;
+		if (!WaveAdd) return len;
+		Bit32u dist = (Bit32u)(left - 1) / WaveAdd;
+		return (dist < len ? dist : len);
+	}
+
+	//DBP: Number of upcoming RampUpdate calls that will not reach a boundary
+	INLINE Bitu RampRunLength(Bitu len) const {
+		if (RampCtrl & 0x3) return len;
+		// Same signed distance as RampLeft in RampUpdate
+		Bit32s left = (Bit32s)((RampCtrl & 0x40) ? (RampVol - RampStart) : (RampEnd - RampVol));
+		if (left <= 0) return 0;
+		if (!RampAdd) return len;
+		Bit32u dist = (Bit32u)(left - 1) / RampAdd;
+		return (dist < len ? dist : len);
+	}
+
+	//DBP: Render a run of samples during which neither the wave position nor the volume ramp reach a boundary
+	template <bool is16, bool interpolate, bool ramping> void generateRun(Bit32s * stream,Bitu len) {
+		Bit32u addr = WaveAddr;
+		const Bit32u addrstep = ((WaveCtrl & (WCTRL_STOP | WCTRL_STOPPED)) ? 0 : (WaveCtrl & WCTRL_DECREASING) ? (Bit32u)-(Bit32s)WaveAdd : WaveAdd);
+		if (!ramping) {
+			const Bit32s volL = VolLeft, volR = VolRight;
+			if (volL | volR) {
+				for (Bit32s *s = stream, *send = stream + len * 2; s != send; s += 2, addr += addrstep) {
+					Bit32s tmpsamp = (is16 ? GetSample16<interpolate>(addr) : GetSample8<interpolate>(addr));
+					s[0] += tmpsamp * volL;
+					s[1] += tmpsamp * volR;
+				}
+			}
+			else addr += addrstep * (Bit32u)len;
+		} else {
+			const Bit32u rampstep = ((RampCtrl & 0x40) ? (Bit32u)-(Bit32s)RampAdd : RampAdd);
+			for (Bit32s *s = stream, *send = stream + len * 2; s != send; s += 2, addr += addrstep) {
+				if (VolLeft | VolRight) {
+					Bit32s tmpsamp = (is16 ? GetSample16<interpolate>(addr) : GetSample8<interpolate>(addr));
+					s[0] += tmpsamp * VolLeft;
+					s[1] += tmpsamp * VolRight;
+				}
+				RampVol += rampstep;
+				UpdateVolumes();
+			}
+		}
+		WaveAddr = addr;
+	}
+
 	void generateSamples(Bit32s * stream,Bitu len) {
 		//Disabled channel
 		if (RampCtrl & WaveCtrl & 3) return;
 		bool is16 = (WaveCtrl & WCTRL_16BIT)!=0;
 
-		for (Bitu i=0; i < len; i++) {
-			if (myGUS.dacenabled && (VolLeft | VolRight)) {
-				// Get sample
-				Bit32s tmpsamp = is16 ? GetSample16():GetSample8();
-				// Output stereo sample
-				stream[i << 1] += tmpsamp * VolLeft;
-				stream[(i << 1) + 1] += tmpsamp * VolRight;
+		//DBP: Render runs up to the next wave or ramp boundary in one go and only process the boundaries sample by sample
+		for (Bitu i = 0; i < len;) {
+			Bitu run = RampRunLength(WaveRunLength(len - i));
+			if (!run) {
+				if (myGUS.dacenabled && (VolLeft | VolRight)) {
+					// Get sample
+					Bit32s tmpsamp = GetSample();
+					// Output stereo sample
+					stream[i << 1] += tmpsamp * VolLeft;
+					stream[(i << 1) + 1] += tmpsamp * VolRight;
+				}
+				WaveUpdate();
+				RampUpdate();
+				i++;
+				continue;
+			}
+			bool interpolate = (WaveAdd < (1 << WAVE_FRACT)), ramping = !(RampCtrl & 0x3);
+			if (!myGUS.dacenabled) {
+				if (!(WaveCtrl & (WCTRL_STOP | WCTRL_STOPPED))) WaveAddr += ((WaveCtrl & WCTRL_DECREASING) ? (Bit32u)-(Bit32s)WaveAdd : WaveAdd) * (Bit32u)run;
+				if (ramping) { RampVol += ((RampCtrl & 0x40) ? (Bit32u)-(Bit32s)RampAdd : RampAdd) * (Bit32u)run; UpdateVolumes(); }
+			}
+			else switch ((is16 ? 4 : 0) | (interpolate ? 2 : 0) | (ramping ? 1 : 0)) {
+				case 0: generateRun<false, false, false>(stream + i * 2, run); break;
+				case 1: generateRun<false, false, true >(stream + i * 2, run); break;
+				case 2: generateRun<false, true,  false>(stream + i * 2, run); break;
+				case 3: generateRun<false, true,  true >(stream + i * 2, run); break;
+				case 4: generateRun<true,  false, false>(stream + i * 2, run); break;
+				case 5: generateRun<true,  false, true >(stream + i * 2, run); break;
+				case 6: generateRun<true,  true,  false>(stream + i * 2, run); break;
+				case 7: generateRun<true,  true,  true >(stream + i * 2, run); break;
 			}
-			WaveUpdate();
-			RampUpdate();
+			i += run;
 		}
 	}
 };
@@ -24,6 +24,7 @@
 #include "cpu.h"
 #include "../src/cpu/lazyflags.h"
 #include "callback.h"
+#include "dbp_profiler.h"
 
 /*
   DBP: Added replacement of IOFaultCore with fake I/O code from DOSBox-X by Jonathan Campbell
@@ -220,9 +221,6 @@ inline void IO_USEC_write_delay_old() {
 }
 
 
-#define IODELAY_READ_MICROSk (Bit32u)(1024/1.0)
-#define IODELAY_WRITE_MICROSk (Bit32u)(1024/0.75)
-
 inline void IO_USEC_read_delay() {
 	Bits delaycyc = CPU_CycleMax/IODELAY_READ_MICROSk;
 	if(GCC_UNLIKELY(delaycyc > CPU_Cycles)) delaycyc = CPU_Cycles;
@@ -342,7 +340,9 @@ void IO_WriteB(Bitu port,Bitu val) {
 	}
 	else {
 		IO_USEC_write_delay();
+		DBP_PROFILE_BEGIN();
 		io_writehandlers[0][port](port,val,1);
+		DBP_PROFILE_END(KIND_IOWRITE, port);
 	}
 }
 
@@ -385,7 +385,9 @@ void IO_WriteW(Bitu port,Bitu val) {
 	}
 	else {
 		IO_USEC_write_delay();
+		DBP_PROFILE_BEGIN();
 		io_writehandlers[1][port](port,val,2);
+		DBP_PROFILE_END(KIND_IOWRITE, port);
 	}
 }
 
@@ -426,7 +428,11 @@ void IO_WriteD(Bitu port,Bitu val) {
 		CPU_ForceV86FakeIO_Out(port,val,4);
 #endif
 	}
-	else io_writehandlers[2][port](port,val,4);
+	else {
+		DBP_PROFILE_BEGIN();
+		io_writehandlers[2][port](port,val,4);
+		DBP_PROFILE_END(KIND_IOWRITE, port);
+	}
 }
 
 Bitu IO_ReadB(Bitu port) {
@@ -469,7 +475,9 @@ Bitu IO_ReadB(Bitu port) {
 	}
 	else {
 		IO_USEC_read_delay();
+		DBP_PROFILE_BEGIN();
 		retval = io_readhandlers[0][port](port,1);
+		DBP_PROFILE_END(KIND_IOREAD, port);
 	}
 	log_io(0, false, port, retval);
 	return retval;
@@ -514,7 +522,9 @@ Bitu IO_ReadW(Bitu port) {
 	}
 	else {
 		IO_USEC_read_delay();
+		DBP_PROFILE_BEGIN();
 		retval = io_readhandlers[1][port](port,2);
+		DBP_PROFILE_END(KIND_IOREAD, port);
 	}
 	log_io(1, false, port, retval);
 	return retval;
@@ -557,7 +567,9 @@ Bitu IO_ReadD(Bitu port) {
 		return CPU_ForceV86FakeIO_In(port,4);
 #endif
 	} else {
+		DBP_PROFILE_BEGIN();
 		retval = io_readhandlers[2][port](port,4);
+		DBP_PROFILE_END(KIND_IOREAD, port);
 	}
 	log_io(2, false, port, retval);
 	return retval;
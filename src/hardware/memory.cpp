@@ -63,6 +63,7 @@ static struct MemoryBlock {
 } memory;
 
 HostPt MemBase;
+Bit32u MemDirtyPages[(1024*1024)/32];
 
 class IllegalPageHandler : public PageHandler {
 public:
@@ -115,6 +116,7 @@ public:
 		return MemBase+phys_page*MEM_PAGESIZE;
 	}
 	HostPt GetHostWritePt(Bitu phys_page) {
+		MEM_SetPageDirty(phys_page);
 		return MemBase+phys_page*MEM_PAGESIZE;
 	}
 };
@@ -562,6 +564,16 @@ void PreparePCJRCartRom(void) {
 
 HostPt GetMemBase(void) { return MemBase; }
 
+void MEM_ClearDirtyPages(void) {
+	// host pointers in the TLB write to pages without marking them, unlink them to get notified again
+	PAGING_UnlinkDirtyPages();
+	memset(MemDirtyPages, 0, (memory.pages+31)/32*sizeof(Bit32u));
+}
+
+void MEM_SetDirtyPages(void) {
+	memset(MemDirtyPages, 0xFF, sizeof(MemDirtyPages));
+}
+
 class MEMORY:public Module_base{
 private:
 	IO_ReadHandleObject ReadHandler;
@@ -592,6 +604,7 @@ public:
 		 * (Visual C debug mode). We want zeroed memory though. */
 		memset((void*)MemBase,0,memsize*1024*1024);
 		memory.pages = (memsize*1024*1024)/4096;
+		MEM_SetDirtyPages();
 		/* Allocate the data for the different page information blocks */
 		memory.phandlers=new  PageHandler * [memory.pages];
 		memory.mhandles=new MemHandle [memory.pages];
@@ -660,6 +673,7 @@ void DBPSerialize_Memory(DBPArchive& ar)
 	ar.Serialize(memory.lfb.end_page);
 	ar.Serialize(memory.lfb.pages);
 	ar.Serialize(memory.a20);
+	if (ar.mode == DBPArchive::MODE_LOAD) MEM_SetDirtyPages();
 	ar.SerializeSparse(MemBase, (pages * MEM_PAGE_SIZE));
 	ar.SerializeBytes(memory.mhandles, (pages * sizeof(MemHandle)));
 
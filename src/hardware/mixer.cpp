@@ -89,6 +89,9 @@ static Mutex DBP_AudioMutex;
 
 #ifdef C_DBP_LIBRETRO
 bool dbp_swapstereo;
+bool dbp_mixer_polyphase;
+#else
+static const bool dbp_mixer_polyphase = false;
 #endif
 
 
@@ -100,6 +103,16 @@ static INLINE Bit16s MIXER_CLIP(Bits SAMP) {
 	} else return MAX_AUDIO;
 }
 
+#if !defined(__SSE2__) && (_M_IX86_FP == 2 || (defined(_M_AMD64) || defined(_M_X64)))
+#define __SSE2__ 1
+#endif
+#if defined(__SSE2__) && __SSE2__
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define DBP_MIXER_NEON
+#endif
+
 static struct {
 	Bit32s work[MIXER_BUFSIZE][2];
 	//Write/Read pointers for the buffer
@@ -113,10 +126,163 @@ static struct {
 	bool nosound;
 	Bit32u freq;
 	Bit32u blocksize;
+	struct PolyBank* poly_banks;
 } mixer;
 
 Bit8u MixTemp[MIXER_BUFSIZE];
 
+// Shift, saturate and store a contiguous run of the work buffer as interleaved 16-bit output and clear it for the next round
+static void MIXER_OutputAndClear(Bit16s* output, Bit32s (*work)[2], Bitu count, bool swap) {
+	Bitu i = 0;
+#if defined(__SSE2__) && __SSE2__
+	for (; i + 4 <= count; i += 4) {
+		__m128i res = _mm_packs_epi32(_mm_srai_epi32(_mm_loadu_si128((const __m128i*)work[i]), MIXER_VOLSHIFT), _mm_srai_epi32(_mm_loadu_si128((const __m128i*)work[i+2]), MIXER_VOLSHIFT));
+		if (swap) res = _mm_shufflehi_epi16(_mm_shufflelo_epi16(res, 0xB1), 0xB1);
+		_mm_storeu_si128((__m128i*)(output + i*2), res);
+	}
+#elif defined(DBP_MIXER_NEON)
+	for (; i + 4 <= count; i += 4) {
+		int16x8_t res = vcombine_s16(vqshrn_n_s32(vld1q_s32(work[i]), MIXER_VOLSHIFT), vqshrn_n_s32(vld1q_s32(work[i+2]), MIXER_VOLSHIFT));
+		if (swap) res = vrev32q_s16(res);
+		vst1q_s16(output + i*2, res);
+	}
+#endif
+	for (; i != count; i++) {
+		Bit16s l = MIXER_CLIP(work[i][0] >> MIXER_VOLSHIFT), r = MIXER_CLIP(work[i][1] >> MIXER_VOLSHIFT);
+		output[i*2+0] = (swap ? r : l);
+		output[i*2+1] = (swap ? l : r);
+	}
+	memset(work, 0, count * sizeof(work[0]));
+}
+
+static void MIXER_ClearWork(Bitu pos, Bitu count) {
+	for (Bitu run; count; count -= run, pos = 0) {
+		run = MIXER_BUFSIZE - pos;
+		if (run > count) run = count;
+		memset(mixer.work[pos], 0, run * sizeof(mixer.work[0]));
+	}
+}
+
+// Add 16-bit stereo samples at mixer rate without any resampling
+static void MIXER_AddStereo16(Bitu mixpos, const Bit16s* data, Bitu count, Bits vol0, Bits vol1) {
+	for (Bitu run; count; count -= run, data += run*2, mixpos += run) {
+		mixpos &= MIXER_BUFMASK;
+		run = MIXER_BUFSIZE - mixpos;
+		if (run > count) run = count;
+		Bit32s (*work)[2] = mixer.work + mixpos;
+		Bitu i = 0;
+#if defined(__SSE2__) && __SSE2__
+		if (vol0 >= MIN_AUDIO && vol0 <= MAX_AUDIO && vol1 >= MIN_AUDIO && vol1 <= MAX_AUDIO) {
+			// Multiply 16-bit samples with zero extended 16-bit volumes into exact 32-bit products
+			const __m128i vol = _mm_set_epi16(0, (Bit16s)vol1, 0, (Bit16s)vol0, 0, (Bit16s)vol1, 0, (Bit16s)vol0), zero = _mm_setzero_si128();
+			for (; i + 4 <= run; i += 4) {
+				__m128i d = _mm_loadu_si128((const __m128i*)(data + i*2)), *w = (__m128i*)work[i];
+				_mm_storeu_si128(w+0, _mm_add_epi32(_mm_loadu_si128(w+0), _mm_madd_epi16(_mm_unpacklo_epi16(d, zero), vol)));
+				_mm_storeu_si128(w+1, _mm_add_epi32(_mm_loadu_si128(w+1), _mm_madd_epi16(_mm_unpackhi_epi16(d, zero), vol)));
+			}
+		}
+#elif defined(DBP_MIXER_NEON)
+		const Bit32s vols[4] = { (Bit32s)vol0, (Bit32s)vol1, (Bit32s)vol0, (Bit32s)vol1 };
+		const int32x4_t vol = vld1q_s32(vols);
+		for (; i + 4 <= run; i += 4) {
+			int16x8_t d = vld1q_s16(data + i*2);
+			vst1q_s32(work[i+0], vmlaq_s32(vld1q_s32(work[i+0]), vmovl_s16(vget_low_s16(d)), vol));
+			vst1q_s32(work[i+2], vmlaq_s32(vld1q_s32(work[i+2]), vmovl_s16(vget_high_s16(d)), vol));
+		}
+#endif
+		for (; i != run; i++) {
+			work[i][0] += data[i*2+0] * vol0;
+			work[i][1] += data[i*2+1] * vol1;
+		}
+	}
+}
+
+// Windowed sinc coefficients for one cutoff frequency, shared by all channels resampling with the same ratio
+#define MIXER_POLY_PHASE_BITS 8
+#define MIXER_POLY_PHASES (1 << MIXER_POLY_PHASE_BITS)
+#define MIXER_POLY_SHIFT 14
+struct PolyBank {
+	PolyBank* next;
+	Bitu key;
+	Bit16s coefs[MIXER_POLY_PHASES][MIXER_POLY_TAPS];
+};
+
+static double MIXER_BesselI0(double x) {
+	double sum = 1.0, term = 1.0;
+	for (int k = 1; k != 25; k++) {
+		term *= (x * x) / (4.0 * k * k);
+		sum += term;
+	}
+	return sum;
+}
+
+static const Bit16s* MIXER_GetPolyBank(Bitu freq_add) {
+	//When upsampling the cutoff is the Nyquist frequency of the source, when downsampling it gets lowered to the one of the mixer
+	const Bitu key = (freq_add <= FREQ_NEXT ? 1024 : ((FREQ_NEXT * 1024) / freq_add));
+	for (PolyBank* b = mixer.poly_banks; b; b = b->next)
+		if (b->key == key) return b->coefs[0];
+
+	PolyBank* b = new PolyBank;
+	b->key = key;
+	b->next = mixer.poly_banks;
+	mixer.poly_banks = b;
+
+	const double pi = 3.14159265358979323846, beta = 7.0, half = MIXER_POLY_TAPS / 2, cutoff = 0.92 * key / 1024, i0beta = MIXER_BesselI0(beta);
+	for (int p = 0; p != MIXER_POLY_PHASES; p++) {
+		double taps[MIXER_POLY_TAPS], sum = 0;
+		for (int t = 0; t != MIXER_POLY_TAPS; t++) {
+			//Distance of this tap from the interpolated position which sits p/PHASES past the center tap
+			double x = (t - (half - 1)) - (double)p / MIXER_POLY_PHASES, r = x / half;
+			double sinc = (x == 0 ? cutoff : sin(pi * cutoff * x) / (pi * x));
+			double window = (r <= -1.0 || r >= 1.0 ? 0.0 : MIXER_BesselI0(beta * sqrt(1.0 - r * r)) / i0beta);
+			sum += (taps[t] = sinc * window);
+		}
+		//Normalize to unity gain and put the rounding error into the strongest tap
+		Bits total = 0, peak = 0;
+		for (int t = 0; t != MIXER_POLY_TAPS; t++) {
+			b->coefs[p][t] = (Bit16s)floor(taps[t] / sum * (1 << MIXER_POLY_SHIFT) + 0.5);
+			total += b->coefs[p][t];
+			if (b->coefs[p][t] > b->coefs[p][peak]) peak = t;
+		}
+		b->coefs[p][peak] += (Bit16s)((1 << MIXER_POLY_SHIFT) - total);
+	}
+	return b->coefs[0];
+}
+
+static INLINE Bits MIXER_PolyDot(const Bit16s* hist, const Bit16s* coefs) {
+#if defined(__SSE2__) && __SSE2__
+	__m128i sum = _mm_add_epi32(
+		_mm_madd_epi16(_mm_loadu_si128((const __m128i*)(hist+0)), _mm_loadu_si128((const __m128i*)(coefs+0))),
+		_mm_madd_epi16(_mm_loadu_si128((const __m128i*)(hist+8)), _mm_loadu_si128((const __m128i*)(coefs+8))));
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+	return (Bit32s)_mm_cvtsi128_si32(sum) >> MIXER_POLY_SHIFT;
+#elif defined(DBP_MIXER_NEON)
+	int32x4_t sum = vmull_s16(vld1_s16(hist+0), vld1_s16(coefs+0));
+	sum = vmlal_s16(sum, vld1_s16(hist+4), vld1_s16(coefs+4));
+	sum = vmlal_s16(sum, vld1_s16(hist+8), vld1_s16(coefs+8));
+	sum = vmlal_s16(sum, vld1_s16(hist+12), vld1_s16(coefs+12));
+	int32x2_t res = vadd_s32(vget_low_s32(sum), vget_high_s32(sum));
+	return vget_lane_s32(vpadd_s32(res, res), 0) >> MIXER_POLY_SHIFT;
+#else
+	Bit32s sum = 0;
+	for (int t = 0; t != MIXER_POLY_TAPS; t++) sum += hist[t] * coefs[t];
+	return sum >> MIXER_POLY_SHIFT;
+#endif
+}
+
+static void MIXER_FreePolyBanks() {
+	//Make channels that are still around fetch a new bank
+	for (MixerChannel* chan = mixer.channels; chan; chan = chan->next) {
+		chan->poly_bank = NULL;
+		chan->poly_add = 0;
+	}
+	while (PolyBank* b = mixer.poly_banks) {
+		mixer.poly_banks = b->next;
+		delete b;
+	}
+}
+
 MixerChannel * MIXER_AddChannel(MIXER_Handler handler,Bitu freq,const char * name) {
 	MixerChannel * chan=new MixerChannel();
 	chan->scale = 1.0;
@@ -132,6 +298,9 @@ MixerChannel * MIXER_AddChannel(MIXER_Handler handler,Bitu freq,const char * nam
 	chan->last_samples_were_stereo = false;
 	chan->offset[0] = 0;
 	chan->offset[1] = 0;
+	chan->poly_bank = NULL;
+	chan->poly_add = chan->poly_pos = 0;
+	memset(chan->poly_hist, 0, sizeof(chan->poly_hist));
 	mixer.channels = chan;
 	return chan;
 }
@@ -246,6 +415,11 @@ void MixerChannel::AddSilence(void) {
 	}
 	last_samples_were_silence = true;
 	offset[0] = offset[1] = 0;
+	//Restart the polyphase history from the level the silence ramped to
+	for (Bitu i = 0; i != MIXER_POLY_TAPS*2; i++) {
+		poly_hist[0][i] = (Bit16s)nextSample[0];
+		poly_hist[1][i] = (Bit16s)nextSample[1];
+	}
 }
 
 //4 seems to work . Disabled for now
@@ -256,6 +430,41 @@ template<class Type,bool stereo,bool signeddata,bool nativeorder>
 inline void MixerChannel::AddSamples(Bitu len, const Type* data) {
 	last_samples_were_stereo = stereo;
 
+	if (sizeof(Type) == 2 && stereo && signeddata && nativeorder && !interpolate && freq_add == FREQ_NEXT && freq_counter >= FREQ_NEXT && freq_counter < FREQ_NEXT*2 && len) {
+		//Batched path for 16-bit stereo at the mixer rate, output lags one sample behind the input just like below
+		Bitu mixpos = (mixer.pos + done) & MIXER_BUFMASK;
+		mixer.work[mixpos][0] += nextSample[0] * volmul[0];
+		mixer.work[mixpos][1] += nextSample[1] * volmul[1];
+		MIXER_AddStereo16(mixpos + 1, (const Bit16s*)data, len - 1, volmul[0], volmul[1]);
+		prevSample[0] = (len > 1 ? data[len*2-4] : nextSample[0]);
+		prevSample[1] = (len > 1 ? data[len*2-3] : nextSample[1]);
+		nextSample[0] = data[len*2-2];
+		nextSample[1] = data[len*2-1];
+		done += len;
+		last_samples_were_silence = false;
+		poly_add = 0;
+		return;
+	}
+
+	//Coefficients when using the polyphase resampler instead of linear interpolation
+	const Bit16s* poly = NULL;
+	if (interpolate && dbp_mixer_polyphase) {
+		if (poly_add != freq_add) {
+			if (!poly_add) {
+				//The history wasn't kept up while not using the polyphase resampler (or the banks were freed), restart it from the current level
+				poly_pos = 0;
+				for (Bitu i = 0; i != MIXER_POLY_TAPS*2; i++) {
+					poly_hist[0][i] = MIXER_CLIP(nextSample[0]);
+					poly_hist[1][i] = MIXER_CLIP(nextSample[1]);
+				}
+			}
+			poly_bank = MIXER_GetPolyBank(freq_add);
+			poly_add = freq_add;
+		}
+		poly = poly_bank;
+	}
+	else poly_add = 0;
+
 	//Position where to write the data
 	Bitu mixpos = mixer.pos + done;
 	//Position in the incoming data
@@ -369,6 +578,11 @@ inline void MixerChannel::AddSamples(Bitu len, const Type* data) {
 				nextSample[1] = nextSample[1] - (offset[1]*(MIXER_UPRAMP_STEPS*static_cast<Bits>(len)-static_cast<Bits>(pos))) /( MIXER_UPRAMP_STEPS*static_cast<Bits>(len) );
 			}
 #endif
+			if (poly) {
+				poly_pos = (poly_pos + 1) & (MIXER_POLY_TAPS - 1);
+				poly_hist[0][poly_pos] = poly_hist[0][poly_pos + MIXER_POLY_TAPS] = MIXER_CLIP(nextSample[0]);
+				if (stereo) poly_hist[1][poly_pos] = poly_hist[1][poly_pos + MIXER_POLY_TAPS] = MIXER_CLIP(nextSample[1]);
+			}
 		}
 		//Where to write
 		mixpos &= MIXER_BUFMASK;
@@ -377,6 +591,16 @@ inline void MixerChannel::AddSamples(Bitu len, const Type* data) {
 			write[0] += prevSample[0] * volmul[0];
 			write[1] += (stereo ? prevSample[1] : prevSample[0]) * volmul[1];
 		}
+		else if (poly) {
+			//History runs from oldest to newest, the output lands between its two center taps
+			const Bit16s* coefs = poly + ((freq_counter & FREQ_MASK) >> (FREQ_SHIFT - MIXER_POLY_PHASE_BITS)) * MIXER_POLY_TAPS;
+			Bits sample = MIXER_PolyDot(poly_hist[0] + poly_pos + 1, coefs);
+			write[0] += sample*volmul[0];
+			if (stereo) {
+				sample = MIXER_PolyDot(poly_hist[1] + poly_pos + 1, coefs);
+			}
+			write[1] += sample*volmul[1];
+		}
 		else {
 			Bits diff_mul = freq_counter & FREQ_MASK;
 			Bits sample = prevSample[0] + (((nextSample[0] - prevSample[0]) * diff_mul) >> FREQ_SHIFT);
@@ -553,11 +777,8 @@ static void MIXER_Mix(void) {
 static void MIXER_Mix_NoSound(void) {
 	MIXER_MixData(mixer.needed);
 	/* Clear piece we've just generated */
-	for (Bitu i=0;i<mixer.needed;i++) {
-		mixer.work[mixer.pos][0]=0;
-		mixer.work[mixer.pos][1]=0;
-		mixer.pos=(mixer.pos+1)&MIXER_BUFMASK;
-	}
+	MIXER_ClearWork(mixer.pos, mixer.needed);
+	mixer.pos=(mixer.pos+mixer.needed)&MIXER_BUFMASK;
 	/* Reduce count in channels */
 	for (MixerChannel * chan=mixer.channels;chan;chan=chan->next) {
 		if (chan->done>mixer.needed) chan->done-=mixer.needed;
@@ -587,7 +808,11 @@ MIXER_CallBack(void * /*userdata*/, uint8_t *stream, int len) {
 	Bitu index_add = (1<<INDEX_SHIFT_LOCAL);
 	Bitu index = (index_add%need)?need:0;
 
-	Bits sample;
+#ifdef C_DBP_LIBRETRO
+	const bool swap = dbp_swapstereo;
+#else
+	const bool swap = false;
+#endif
 	/* Enough room in the buffer ? */
 	Callback_LockAudio();
 	if (mixer.done < need) {
@@ -661,43 +886,26 @@ MIXER_CallBack(void * /*userdata*/, uint8_t *stream, int len) {
 		while (need--) {
 			Bitu i = (pos + (index >> INDEX_SHIFT_LOCAL )) & MIXER_BUFMASK;
 			index += index_add;
-			sample=mixer.work[i][0]>>MIXER_VOLSHIFT;
-			*output++=MIXER_CLIP(sample);
-			sample=mixer.work[i][1]>>MIXER_VOLSHIFT;
-			*output++=MIXER_CLIP(sample);
+			Bit16s l = MIXER_CLIP(mixer.work[i][0]>>MIXER_VOLSHIFT), r = MIXER_CLIP(mixer.work[i][1]>>MIXER_VOLSHIFT);
+			*output++ = (swap ? r : l);
+			*output++ = (swap ? l : r);
 		}
 		/* Clean the used buffer */
-		while (reduce--) {
-			pos &= MIXER_BUFMASK;
-			mixer.work[pos][0]=0;
-			mixer.work[pos][1]=0;
-			pos++;
-		}
+		MIXER_ClearWork(pos, reduce);
 	} else {
-		while (reduce--) {
-			pos &= MIXER_BUFMASK;
-			sample=mixer.work[pos][0]>>MIXER_VOLSHIFT;
-			*output++=MIXER_CLIP(sample);
-			sample=mixer.work[pos][1]>>MIXER_VOLSHIFT;
-			*output++=MIXER_CLIP(sample);
-			mixer.work[pos][0]=0;
-			mixer.work[pos][1]=0;
-			pos++;
-		}
+		/* Convert and clean in up to two runs as the buffer wraps around */
+		Bitu run = MIXER_BUFSIZE - pos;
+		if (run > reduce) run = reduce;
+		MIXER_OutputAndClear(output, mixer.work + pos, run, swap);
+		if (run != reduce) MIXER_OutputAndClear(output + run*2, mixer.work, reduce - run, swap);
 	}
 	Callback_UnlockAudio();
-
-#ifdef C_DBP_LIBRETRO
-	if (dbp_swapstereo)
-	{
-		for (Bit16s *p = (Bit16s *)stream, *pEnd = p + (size_t)len/2; p != pEnd; p += 2) std::swap(p[0], p[1]);
-	}
-#endif
 }
 
 #undef INDEX_SHIFT_LOCAL
 
 static void MIXER_Stop(Section* /*sec*/) {
+	MIXER_FreePolyBanks();
 }
 
 class MIXER : public Program {
@@ -796,6 +1004,7 @@ void MIXER_Init(Section* sec) {
 
 	/* Initialize the internal stuff */
 	mixer.channels=0;
+	mixer.poly_banks=NULL;
 	mixer.pos=0;
 	mixer.done=0;
 	memset(mixer.work,0,sizeof(mixer.work));
@@ -1413,40 +1413,57 @@ void NukedOPL::Handler::Generate(MixerChannel* chan, Bitu samples)
         #endif
 
         chan->AddSamples_s16(block, buf);
+        UpdateActive(block);
+    }
+}
+
+bool NukedOPL::Handler::Render(Bit32s* out, Bitu samples)
+{
+    Bit16s buf[2];
+    for (Bit32s *out_end = out + samples * 2; out != out_end; out += 2)
+    {
+        OPL3_Generate(&chip, buf);
+        out[0] = buf[0];
+        out[1] = buf[1];
+    }
+    UpdateActive(samples);
+    return true;
+}
 
-        #ifndef DBP_NUKED_BIT_ACCURATE
-        active_check += (Bit16u)block;
-        Bit16u reduce_active = (active_check / 128);
-        if (reduce_active)
+void NukedOPL::Handler::UpdateActive(Bitu samples)
+{
+    #ifndef DBP_NUKED_BIT_ACCURATE
+    active_check += (Bit16u)samples;
+    Bit16u reduce_active = (active_check / 128);
+    if (reduce_active)
+    {
+        active_check %= 128;
+        for (opl3_slot& slot : chip.slot)
         {
-            active_check %= 128;
-            for (opl3_slot& slot : chip.slot)
+            if (!slot.active) continue;
+            if (slot.eg_gen == envelope_gen_num_release && slot.eg_rout == 0x1ff && slot.eg_out > 510 && slot.out == slot.prout && slot.out >= -1 && slot.out <= 1)
             {
-                if (!slot.active) continue;
-                if (slot.eg_gen == envelope_gen_num_release && slot.eg_rout == 0x1ff && slot.eg_out > 510 && slot.out == slot.prout && slot.out >= -1 && slot.out <= 1)
-                {
-                    slot.active = (reduce_active > slot.active ? 0 : (slot.active - reduce_active));
-                }
-                else
-                {
-                    slot.active = 255;
-                }
+                slot.active = (reduce_active > slot.active ? 0 : (slot.active - reduce_active));
+            }
+            else
+            {
+                slot.active = 255;
             }
         }
-        #endif
     }
+    #endif
 }
 
 void NukedOPL::Handler::WriteReg(Bit32u reg, Bit8u val)
 {
     OPL3_WriteRegBuffered(&chip, (Bit16u)reg, val);
     if (reg == 0x105)
-        newm = reg & 0x01;
+        newm = val & 0x01;
 
     #ifdef DBP_NUKED_COMPARE_ORG
     NukedOPLOrg::OPL3_WriteRegBuffered(&NukedOPLOrg::chip, (Bit16u)reg, val);
     if (reg == 0x105)
-        NukedOPLOrg::newm = reg & 0x01;
+        NukedOPLOrg::newm = val & 0x01;
     #endif
 }
 
@@ -143,7 +143,9 @@ namespace NukedOPL
         virtual void WriteReg(Bit32u reg, Bit8u val);
         virtual Bit32u WriteAddr(Bit32u port, Bit8u val);
         virtual void Generate(MixerChannel* chan, Bitu samples);
+        virtual bool Render(Bit32s* out, Bitu samples);
         virtual void Init(Bitu rate);
+        void UpdateActive(Bitu samples);
     };
 }
 
@@ -23,6 +23,7 @@
 #include "pic.h"
 #include "timer.h"
 #include "setup.h"
+#include "dbp_profiler.h"
 
 #define PIC_QUEUESIZE 512
 
@@ -113,6 +114,7 @@ static PIC_Controller pics[2];
 static PIC_Controller& master = pics[0];
 static PIC_Controller& slave  = pics[1];
 Bitu PIC_Ticks = 0;
+Bitu PIC_Slices = 0;
 Bitu PIC_IRQCheck = 0; //Maybe make it a bool and/or ensure 32bit size (x86 dynamic core seems to assume 32 bit variable size)
 
 
@@ -171,6 +173,11 @@ struct PICEntry {
 	PICEntry * next;
 };
 
+// Kept as a sorted singly linked list on purpose: in practice only a handful of events
+// are pending at once (around 4 to 5 with PIT, speaker and MPU-401 active, 6 to 7 with
+// GUS timers and VGA) and a linear insert beats a binary heap or sorted array until well
+// over 50 pending events. Removal handles would not pay off either, PIC_RemoveEvents and
+// PIC_RemoveSpecificEvents run a few times per mode change or reset, not per event.
 static struct {
 	PICEntry entries[PIC_QUEUESIZE];
 	PICEntry * free_entry;
@@ -471,6 +478,7 @@ void PIC_RemoveEvents(PIC_EventHandler handler) {
 
 
 bool PIC_RunQueue(void) {
+	PIC_Slices++;
 	/* Check to see if a new millisecond needs to be started */
 	CPU_CycleLeft+=CPU_Cycles;
 	CPU_Cycles=0;
@@ -485,7 +493,9 @@ bool PIC_RunQueue(void) {
 		pic_queue.next_entry=entry->next;
 
 		srv_lag = entry->index;
+		DBP_PROFILE_BEGIN();
 		(entry->pic_event)(entry->value); // call the event handler
+		DBP_PROFILE_END(KIND_PIC, entry->pic_event);
 
 		/* Put the entry in the free list */
 		entry->next=pic_queue.free_entry;
@@ -676,6 +686,7 @@ void DBPSerialize_PIC(DBPArchive& ar)
 	}
 
 	ar.SerializeArray(pics).Serialize(PIC_Ticks).Serialize(PIC_IRQCheck).Serialize(pic_count);
+	if (ar.version >= 9) ar.Serialize(PIC_Slices);
 	ar.SerializeBytes(pic_indices, pic_count * sizeof(*pic_indices));
 	ar.SerializeBytes(pic_values, pic_count * sizeof(*pic_values));
 	ar.SerializePointers((void**)pic_events, pic_count, false, 14,
@@ -707,7 +707,9 @@ public:
 		return vga.tandy.mem_base + (phys_page * 4096);
 	}
 	HostPt GetHostWritePt(Bitu phys_page) {
-		return GetHostReadPt( phys_page );
+		HostPt res = GetHostReadPt( phys_page );
+		if (vga.tandy.mem_base != vga.mem.linear) MEM_SetPageDirty((Bitu)(res - MemBase) >> 12); // video memory is in system ram
+		return res;
 	}
 };
 
@@ -725,7 +727,9 @@ public:
 		return vga.tandy.mem_base + (phys_page * 4096);
 	}
 	HostPt GetHostWritePt(Bitu phys_page) {
-		return GetHostReadPt( phys_page );
+		HostPt res = GetHostReadPt( phys_page );
+		if (vga.tandy.mem_base != vga.mem.linear) MEM_SetPageDirty((Bitu)(res - MemBase) >> 12); // video memory is in system ram
+		return res;
 	}
 };
 
@@ -58,6 +58,24 @@ Bitu vga_read_p3da(Bitu /*port*/,Bitu /*iolen*/) {
 	return retval;
 }
 
+// Time in milliseconds from PIC index 'since' until one of the bits in mask of the value returned by vga_read_p3da changes
+double VGA_StatusChangeDelay(Bit8u mask, double since) {
+	double timeInFrame = since-vga.draw.delay.framestart;
+	if (vga.draw.delay.htotal <= 0 || timeInFrame < 0) return 0;
+	if (mask & 0x80) mask |= 8;
+	double next = vga.draw.delay.vtotal; // a new frame starts in a PIC event
+	if ((mask & 8) && timeInFrame <= vga.draw.delay.vrend)
+		next = (timeInFrame < vga.draw.delay.vrstart ? vga.draw.delay.vrstart : vga.draw.delay.vrend);
+	if ((mask & 1) && timeInFrame < vga.draw.delay.vdend) {
+		double lineStart = timeInFrame - fmod(timeInFrame,vga.draw.delay.htotal), timeInLine = timeInFrame - lineStart;
+		double lineNext = lineStart + (timeInLine < vga.draw.delay.hblkstart ? vga.draw.delay.hblkstart :
+			(timeInLine <= vga.draw.delay.hblkend ? vga.draw.delay.hblkend : vga.draw.delay.htotal));
+		if (lineNext > vga.draw.delay.vdend) lineNext = vga.draw.delay.vdend;
+		if (lineNext < next) next = lineNext;
+	}
+	return next - timeInFrame;
+}
+
 static void write_p3c2(Bitu /*port*/,Bitu val,Bitu /*iolen*/) {
 	vga.misc_output=val;
 